@@ -27,6 +27,26 @@
 #define TIMER_PRESCALAR (1 << CS52 | 1 << CS50)
 #define TICKS 12499
 
+/**
+ * @brief Timer5 count up to which a game tick may start drawing its frame.
+ *
+ * A tick which finishes its simulation later than this skips the
+ * frame, so that the simulation keeps to the tick rate.
+ */
+#define RENDER_DEADLINE (TICKS * 3UL / 4)
+
+/**
+ * @brief How many ticks may be pending before further ones are dropped.
+ *
+ * Pending ticks are caught up by simulating without drawing, up to 
+ * this many. After longer stalls the game slows down instead of racing.
+ */
+#define MAX_PENDING_TICKS 4
+
+// Wiimote button bits, as reported to rcvButton
+#define BUTTON_B 0x0004
+#define BUTTON_A 0x0008
+
 /**
  * @brief How many labyrinth tiles to generate in
  * one iteration of loading
@@ -40,10 +60,10 @@
 #define GHOST_FREE_TILES 4
  
 /**
- * @brief Set if there was a timer tick.
+ * @brief Number of timer ticks not handled yet.
  *
- * Timer ticked is equal to 1 if there was a timer 
- * tick since the last time it was manually reset.
+ * Counted up by the timer, up to MAX_PENDING_TICKS, and 
+ * counted down by the main loop.
  */
 static volatile uint8_t timerTicked = 0;
 
@@ -59,7 +79,7 @@ static volatile uint8_t introOver = 0;
 /**
  * @brief ISR for the main file timer.
  *
- * Sets timerTicked to 1. If introOver is
+ * Counts up timerTicked. If introOver is
  * set to 1, it will set the speed at 20Hz,
  * and set introOver to 0.
  */
@@ -72,7 +92,9 @@ ISR (TIMER5_COMPA_vect)
 		OCR5A |= 12499;
 		introOver = 0;
 	}
-	timerTicked = 1;
+	if(timerTicked < MAX_PENDING_TICKS) {
+		++timerTicked;
+	}
 }
 
 /**
@@ -216,6 +238,11 @@ extern const uint8_t _mac[1][6];
  */
 static uint8_t userConnected = 0;
 
+/**
+ * @brief Set while the minimap is to be shown, i.e. while B is held.
+ */
+static volatile uint8_t showMinimap = 0;
+
 /**
  * @brief One iteration of the main program loop.
  */
@@ -348,20 +375,24 @@ int main(void)
 	}
 	introOver = 1;
 	
+	// the intro may end before the first tick, conCallback only retries failed attempts
 	if(!userConnected) {
-		if(timerTicked != 0) {
-			timerTicked = 0;
-			wiiUserConnect(0, _mac, conCallback);
-		}
+		wiiUserConnect(0, _mac, conCallback);
 	}
 	
 	//wiiUserSetRumbler(0, 1, setRumblerCallback);
 	gameState = LOADING_STATE;
 	while(running) {
 		if(timerTicked != 0) {
-			timerTicked = 0;
+			ATOMIC_BLOCK(ATOMIC_FORCEON)
+			{
+				--timerTicked;
+			}
 			mainIteration();
 		}
+		else {
+			renderBckg();
+		}
 		sleep_cpu();
 	}
 }
@@ -374,22 +405,29 @@ static void mainIteration(void)
 	}
 	else if(!userConnected) {
 		updateAnimations();
-		startRender();
 		drawConnectingScreen();
 		endRender();
 	}
 	else if(userConnected && gameState == GAME_STATE) {
 		gameIteration();
+		updateMinimap();
+		// a late tick only simulates, the frame of the next one shows its result
+		if(timerTicked != 0 || TCNT5 > RENDER_DEADLINE) {
+			skipRender();
+			return;
+		}
 		updateCamera();
-		startRender();
+		startMazeRender();
 		renderMaze(maze, points);
 		renderPlayer();
 		renderGhosts(ghosts, GHOST_COUNT);
+		if(showMinimap) {
+			renderMinimap();
+		}
 		endRender();
 	}
 	else if(userConnected && (gameState == WIN_STATE || gameState == LOSE_STATE)) {
 		updateAnimations();
-		startRender();
 		drawEndScreen(((gameState == WIN_STATE)?1:0), score);
 		endRender();
 	}
@@ -414,6 +452,7 @@ static void loadIteration(void)
 	}
 	else {
 		generateGhosts();
+		buildMinimap(maze, points);
 		loadState = LOADING_COMPLETE;
 		gameState = GAME_STATE;
 	}
@@ -544,7 +583,8 @@ static void generateGhosts(void) {
 
 static void rcvButton(uint8_t wii, uint16_t buttonStates)
 {
-	if(buttonStates == 0x0008 && (gameState == WIN_STATE || gameState == LOSE_STATE)) {
+	showMinimap = ((buttonStates & BUTTON_B) != 0);
+	if(buttonStates == BUTTON_A && (gameState == WIN_STATE || gameState == LOSE_STATE)) {
 		gameState = LOADING_STATE;
 	}
 }
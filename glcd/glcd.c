@@ -4,224 +4,786 @@
 
 #include <avr/pgmspace.h> 
 #include <stdlib.h>
+#include <string.h>
+
+#ifdef USE_FRAME_BUFFER
+#define FRAME_BUFFER_HEIGHT (SCREEN_HEIGHT / 8)
+// stored page by page, so that a page is one run of memory like on the screen
+static uint8_t frameBuffer[FRAME_BUFFER_HEIGHT][SCREEN_WIDTH];
+
+// per page column span [dirtyFrom, dirtyTo] changed since the last flush.
+// A page is clean when dirtyFrom > dirtyTo.
+static uint8_t dirtyFrom[FRAME_BUFFER_HEIGHT];
+static uint8_t dirtyTo[FRAME_BUFFER_HEIGHT];
+
+// widens the dirty span of a page so it contains the columns x0 to x1
+static inline void markDirty(const uint8_t page, const uint8_t x0, const uint8_t x1);
+
+// marks every page of the framebuffer as dirty
+static void markAllDirty(void);
+
+// sends the columns from to to of one page and counts the traffic
+static void flushSpan(const uint8_t page, const uint8_t from, const uint8_t to);
+
+// page the running flush is at, FRAME_BUFFER_HEIGHT if no flush is running
+static uint8_t flushPage = FRAME_BUFFER_HEIGHT;
+
+// next column of flushPage to be looked at, and the last one to be looked at
+static uint8_t flushCol;
+static uint8_t flushTo;
+
+// where the address counter of the display points to, so that
+// a flush resumed mid run does not need to set the address again
+static uint8_t panelPage = 0xFF;
+static uint8_t panelCol;
+
+// start line the display is set to, and the one to set it to
+// once the running flush has sent the frame drawn for it
+static uint8_t panelYShift;
+static uint8_t flushYShift;
+
+// takes over the dirty span of flushPage, so that anything drawn 
+// while the page is being flushed marks it dirty again
+static void takeDirtySpan(void);
+
+// last column of the run starting at flushCol, which is at most budget bytes long
+static uint8_t runEnd(const uint8_t budget);
+
+// sends the dirty columns of one page between x0 and x1 and takes them off its dirty span
+static void flushPageRegion(const uint8_t page, const uint8_t x0, const uint8_t x1);
+
+// runs crossing the middle of the screen are written alternating between
+// the two controllers if set. Only cleared for benchmarking.
+static uint8_t interleaveFlush = 1;
+
+// flushes the full framebuffer with the given strategy and measures it
+static void benchFullFlush(const uint8_t interleave, glcd_flush_bench *result);
 
 /**
- * @brief When this define exists a framebuffer is used.
- * 
- * If the define is deleted, the code defaults back to direct writing.
- * Slow, and very much not recomended.
+ * @brief When this define exists, the flush compares the framebuffer
+ * against a copy of what was last sent and only sends the differences.
+ *
+ * Costs another SCREEN_WIDTH * FRAME_BUFFER_HEIGHT bytes of RAM, on top
+ * of the framebuffer, the maze and the points, so it is off by default.
+ * The dirty spans already keep unchanged pages from being sent.
  */
-#define USE_FRAME_BUFFER
+//#define USE_SHADOW_FLUSH
 
-#ifdef USE_FRAME_BUFFER
-#define FRAME_BUFFER_HEIGHT (SCREEN_HEIGHT / 8)
-static uint8_t frameBuffer[SCREEN_WIDTH][FRAME_BUFFER_HEIGHT];
+#ifdef USE_SHADOW_FLUSH
+/**
+ * @brief Longest run of unchanged bytes which is still sent
+ * instead of starting a new run.
+ *
+ * Moving the address costs two commands, which take about as 
+ * long as two data writes.
+ */
+#define SHADOW_MERGE_GAP 2
+
+// what the screen currently shows
+static uint8_t shadowBuffer[FRAME_BUFFER_HEIGHT][SCREEN_WIDTH];
+
+// set once the screen has received a full frame and matches shadowBuffer
+static uint8_t shadowValid;
+#endif
 #endif
 
+// the framebuffer is a ring of rows. Screen row y is stored in row
+// (y + yShift) % SCREEN_HEIGHT, which is where the display starts showing it.
 static uint8_t yShift;
 
+// row of the framebuffer a screen row is stored in
+#define RING_ROW(y) (((y) + yShift) & (SCREEN_HEIGHT - 1))
+
+// clip rectangle in screen coordinates, both corners included.
+// Nothing outside of it is drawn.
+static uint8_t clipX0 = 0;
+static uint8_t clipY0 = 0;
+static uint8_t clipX1 = SCREEN_WIDTH - 1;
+static uint8_t clipY1 = SCREEN_HEIGHT - 1;
+
+// world coordinates shown in the top left corner of the screen
+static int16_t viewX;
+static int16_t viewY;
+
+// screen coordinates of world coordinates
+#define VIEW_X(x) ((int16_t)(x) - viewX)
+#define VIEW_Y(y) ((int16_t)(y) - viewY)
+
+/**
+ * @brief When this define exists, the columns of recently drawn glyphs
+ * are kept in RAM instead of being read from progmem every time.
+ *
+ * Costs GLYPH_CACHE_SIZE * (GLYPH_CACHE_WIDTH + 3) bytes of RAM.
+ */
+#define USE_GLYPH_CACHE
+
+#ifdef USE_GLYPH_CACHE
+// number of glyphs cached. A glyph is cached in the entry c % GLYPH_CACHE_SIZE,
+// so the digits never push each other out.
+#define GLYPH_CACHE_SIZE 16
+
+// widest font which is cached
+#define GLYPH_CACHE_WIDTH 6
+
+typedef struct glyph_entry_t {
+	const font *f;
+	char c;
+	uint8_t columns[GLYPH_CACHE_WIDTH];
+} glyph_entry;
+
+static glyph_entry glyphCache[GLYPH_CACHE_SIZE];
+#endif
+
+// the columns of c in RAM, loaded into the glyph cache if needed.
+// Returns NULL if the glyph can not be cached.
+static const uint8_t *glyphLookup(const char c, const font *f);
+
+// bit of a page byte for each row, cheaper than shifting on the avr
+static const uint8_t rowBit[8] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80};
+
+// bits of a page byte from a row to the bottom of the page, and from the top to a row
+static const uint8_t rowsFrom[8] = {0xFF, 0xFE, 0xFC, 0xF8, 0xF0, 0xE0, 0xC0, 0x80};
+static const uint8_t rowsTo[8] = {0x01, 0x03, 0x07, 0x0F, 0x1F, 0x3F, 0x7F, 0xFF};
+
+// finds the raster operation a pixel function stands for.
+// Returns 0 if drawPx is not one of the glcd pixel functions.
+static uint8_t ropOf(void (*drawPx)(const uint8_t, const uint8_t), glcd_rop_t *rop);
+
+// replaces the bits in mask of one page byte by the ones of img
+static inline void maskByte(const uint8_t page, const uint8_t x, const uint8_t img, const uint8_t mask);
+
+// draws width column bytes from cols, in progmem if inPgm is set, as 8 rows with 
+// the top left corner at (x, y) in screen coordinates. Replaces everything below.
+static void blitColumns(const uint8_t *cols, const uint8_t inPgm, const int16_t x, const int16_t y, const uint8_t width);
+
+// data bytes sent to the display during the last flush
+static uint16_t flushByteCount;
+
+// address commands sent to the display during the last flush
+static uint8_t flushAddressCount;
+
+#ifdef USE_FRAME_BUFFER
+// framebuffer bytes drawn to since the last flush was started
+static uint16_t touchedByteCount;
+#endif
+
+// framebuffer bytes drawn to for the frame the last flush started with
+static uint16_t flushTouchedByteCount;
+
+// calls drawPx for a pixel in screen coordinates, if it is inside the clip rectangle
+static inline void clippedPx(const int16_t x, const int16_t y, 
+							void (*drawPx)(const uint8_t, const uint8_t))
+{
+	if(x >= clipX0 && x <= clipX1 && y >= clipY0 && y <= clipY1) {
+		drawPx(x, y);
+	}
+}
+
+// one set of drawing kernels specialized for each raster operation,
+// and one calling back a pixel function for everything else
+#define KERNEL(name) name##Set
+#define KERNEL_BYTE(b, m) ((b) |= (m))
+#define KERNEL_ARGS
+#define KERNEL_PASS
+#include "glcd_kernels.h"
+
+#define KERNEL(name) name##Clear
+#define KERNEL_BYTE(b, m) ((b) &= ~(m))
+#define KERNEL_ARGS
+#define KERNEL_PASS
+#include "glcd_kernels.h"
+
+#define KERNEL(name) name##Invert
+#define KERNEL_BYTE(b, m) ((b) ^= (m))
+#define KERNEL_ARGS
+#define KERNEL_PASS
+#include "glcd_kernels.h"
+
+#define KERNEL(name) name##Px
+#define KERNEL_PX(x, y) clippedPx(x, y, drawPx)
+#define KERNEL_ARGS , void (*drawPx)(const uint8_t, const uint8_t)
+#define KERNEL_PASS , drawPx
+#include "glcd_kernels.h"
+
+// calls the kernel specialized for rop
+#define ROP_DISPATCH(rop, kernel, ...) \
+	switch(rop) { \
+	case ROP_SET: \
+		kernel##Set(__VA_ARGS__); \
+		break; \
+	case ROP_CLEAR: \
+		kernel##Clear(__VA_ARGS__); \
+		break; \
+	default: \
+		kernel##Invert(__VA_ARGS__); \
+		break; \
+	}
+
+// calls the kernel specialized for the raster operation of drawPx,
+// or the callback kernel if drawPx is some other function
+#define PX_DISPATCH(drawPx, kernel, ...) \
+	glcd_rop_t rop; \
+	if(ropOf(drawPx, &rop)) { \
+		ROP_DISPATCH(rop, kernel, __VA_ARGS__); \
+	} \
+	else { \
+		kernel##Px(__VA_ARGS__, drawPx); \
+	}
+
 void glcdFlushFramebuffer(void)
+{
+	glcdFlushBegin();
+	while(!glcdFlushStep(0xFF)) {
+	}
+}
+
+void glcdFlushRegion(const uint8_t x0, const uint8_t y0, const uint8_t x1, const uint8_t y1)
 {
 #ifdef USE_FRAME_BUFFER
-	for(uint8_t j = 0; j < FRAME_BUFFER_HEIGHT; ++j) {
-		halGlcdSetAddress(0, j);
-		for(uint8_t i = 0; i < SCREEN_WIDTH; ++i) {
-			halGlcdWriteData(frameBuffer[i][j]);
+	// one framebuffer page at a time, the rows may wrap around the ring
+	uint8_t y = y0;
+	while(y <= y1 && y < SCREEN_HEIGHT) {
+		uint8_t row = RING_ROW(y);
+		flushPageRegion(row / 8, x0, (x1 < SCREEN_WIDTH) ? x1 : SCREEN_WIDTH - 1);
+		y += 8 - row % 8;
+	}
+#endif
+}
+
+void glcdFlushBegin(void)
+{
+#ifdef USE_FRAME_BUFFER
+	// the part of its page a running flush took over but did not send yet
+	// is dirty again, the pages after it still are
+	if(flushPage < FRAME_BUFFER_HEIGHT && flushCol <= flushTo) {
+		if(flushCol < dirtyFrom[flushPage]) {
+			dirtyFrom[flushPage] = flushCol;
+		}
+		if(flushTo > dirtyTo[flushPage]) {
+			dirtyTo[flushPage] = flushTo;
+		}
+	}
+	flushByteCount = 0;
+	flushAddressCount = 0;
+	flushTouchedByteCount = touchedByteCount;
+	touchedByteCount = 0;
+	flushPage = 0;
+	flushYShift = yShift;
+	takeDirtySpan();
+#endif
+}
+
+uint8_t glcdFlushStep(uint8_t budget)
+{
+#ifdef USE_FRAME_BUFFER
+	while(flushPage < FRAME_BUFFER_HEIGHT) {
+		if(flushCol > flushTo) {
+			++flushPage;
+			takeDirtySpan();
+			continue;
+		}
+		if(budget == 0) {
+			return 0;
 		}
+#ifdef USE_SHADOW_FLUSH
+		if(shadowValid && frameBuffer[flushPage][flushCol] == shadowBuffer[flushPage][flushCol]) {
+			++flushCol;
+			continue;
+		}
+#endif
+		uint8_t to = runEnd(budget);
+		flushSpan(flushPage, flushCol, to);
+		budget -= to - flushCol + 1;
+		flushCol = to + 1;
+	}
+#ifdef USE_SHADOW_FLUSH
+	shadowValid = 1;
+#endif
+	// scroll only once the whole frame is there
+	if(panelYShift != flushYShift) {
+		panelYShift = flushYShift;
+		halGlcdSetYShift(panelYShift);
 	}
+#endif
+	return 1;
+}
+
+uint8_t glcdFlushComplete(void)
+{
+#ifdef USE_FRAME_BUFFER
+	return flushPage >= FRAME_BUFFER_HEIGHT;
+#else
+	return 1;
+#endif
+}
+
+uint16_t glcdGetFlushByteCount(void)
+{
+	return flushByteCount;
+}
+
+uint8_t glcdGetFlushAddressCount(void)
+{
+	return flushAddressCount;
+}
+
+uint16_t glcdGetTouchedByteCount(void)
+{
+	return flushTouchedByteCount;
+}
+
+void glcdBenchmarkFlush(glcd_flush_bench *sequential, glcd_flush_bench *interleaved)
+{
+#ifdef USE_FRAME_BUFFER
+	glcdFlushFramebuffer();
+	benchFullFlush(0, sequential);
+	benchFullFlush(1, interleaved);
 #endif
 }
 
 void glcdInit(void)
 {
 	halGlcdInit();
-	glcdFillScreen(0x00);
+	glcdClearScreen(0x00);
 }
 
 /*
- * @param x coord in range 0 <= x <= 127
- * @param y coord in range 0 <= y <= 63
+ * @param x world coord, moved by the viewport
+ * @param y world coord, moved by the viewport
+ * Pixels outside the clip rectangle are left out.
  */
 void glcdSetPixel(const uint8_t x, const uint8_t y)
 {
-	uint8_t yRoundDown = y / 8;
-	uint8_t yInByte = y % 8;
+	pxSet(VIEW_X(x), VIEW_Y(y));
+}
+
+void glcdClearPixel(const uint8_t x, const uint8_t y)
+{
+	pxClear(VIEW_X(x), VIEW_Y(y));
+}
+
+void glcdInvertPixel(const uint8_t x, const uint8_t y)
+{
+	pxInvert(VIEW_X(x), VIEW_Y(y));
+}
+
+void glcdDrawLine(const xy_point p1, const xy_point p2,
+					void (*drawPx)(const uint8_t, const uint8_t))
+{
+	PX_DISPATCH(drawPx, drawLine, p1, p2);
+}
+
+void glcdDrawLineOp(const xy_point p1, const xy_point p2, const glcd_rop_t rop)
+{
+	ROP_DISPATCH(rop, drawLine, p1, p2);
+}
+
+void glcdDrawVertical(const uint8_t x,
+					void (*drawPx)(const uint8_t, const uint8_t))
+{
+	PX_DISPATCH(drawPx, drawVertical, x);
+}
+
+void glcdDrawVerticalOp(const uint8_t x, const glcd_rop_t rop)
+{
+	ROP_DISPATCH(rop, drawVertical, x);
+}
+
+void glcdDrawRect(const xy_point p1, const xy_point p2,
+				void (*drawPx)(const uint8_t, const uint8_t))
+{
+	PX_DISPATCH(drawPx, drawRect, p1, p2);
+}
+
+void glcdDrawRectOp(const xy_point p1, const xy_point p2, const glcd_rop_t rop)
+{
+	ROP_DISPATCH(rop, drawRect, p1, p2);
+}
+
+void glcdFillScreen(const uint8_t pattern)
+{
 	
 #ifdef USE_FRAME_BUFFER
-	frameBuffer[x][yRoundDown] |= (1 << yInByte);
+	memset(frameBuffer, pattern, sizeof(frameBuffer));
+	markAllDirty();
 #else
-	halGlcdSetAddress(x, yRoundDown);
-	uint8_t currVal = halGlcdReadData();
-	currVal |= (0x01 << yInByte);
-	halGlcdSetAddress(x, yRoundDown);
-	halGlcdWriteData(currVal);
+	glcdClearScreen(pattern);
 #endif
 
 }
 
-void glcdClearPixel(const uint8_t x, const uint8_t y)
+void glcdClearScreen(const uint8_t pattern)
 {
-	uint8_t yRoundDown = y / 8;
-	uint8_t yInByte = y % 8;
+	for(uint8_t y = 0; y < 8; ++y) {
+		halGlcdWriteBroadcast(y, 0, pattern, SCREEN_WIDTH / 2);
+	}
 	
 #ifdef USE_FRAME_BUFFER
-	frameBuffer[x][yRoundDown] &= ~(1 << yInByte);
+	memset(frameBuffer, pattern, sizeof(frameBuffer));
+	touchedByteCount += sizeof(frameBuffer);
+#ifdef USE_SHADOW_FLUSH
+	memset(shadowBuffer, pattern, sizeof(shadowBuffer));
+#endif
+	for(uint8_t j = 0; j < FRAME_BUFFER_HEIGHT; ++j) {
+		dirtyFrom[j] = 0xFF;
+		dirtyTo[j] = 0;
+	}
+	// the screen already shows the framebuffer, a running flush is pointless
+	flushPage = FRAME_BUFFER_HEIGHT;
+	panelPage = 0xFF;
+#ifdef USE_SHADOW_FLUSH
+	shadowValid = 1;
+#endif
+#endif
+}
+
+void glcdDrawArrayPgm(PGM_P array, uint16_t len)
+{
+	// a full screen image starts the ring over
+	glcdSetYShift(0);
+#ifdef USE_FRAME_BUFFER
+	// the array has the same layout as the framebuffer
+	memcpy_P(frameBuffer, array, sizeof(frameBuffer));
+	markAllDirty();
 #else
-	halGlcdSetAddress(x, yRoundDown);
-	uint8_t currVal = halGlcdReadData();
-	currVal &= ~(0x01 << yInByte);
-	halGlcdSetAddress(x, yRoundDown);
-	halGlcdWriteData(currVal);
+	uint16_t arrIdx = 0;
+	uint8_t line[SCREEN_WIDTH];
+	for(uint8_t y = 0; y < 8; ++y) {
+		for(uint8_t x = 0; x < 128; ++x) {
+			line[x] = pgm_read_byte(&array[arrIdx++]);
+		}
+		halGlcdWriteBurst(y, 0, line, SCREEN_WIDTH);
+	}
 #endif
 }
 
-void glcdInvertPixel(const uint8_t x, const uint8_t y)
+// unpacks one page of an image packed for glcdDrawRleImagePgm into line,
+// returns where the next page starts
+static PGM_P unpackRlePage(PGM_P image, uint8_t *line)
 {
-	uint8_t yRoundDown = y / 8;
-	uint8_t yInByte = y % 8;
+	uint8_t *end = line + SCREEN_WIDTH;
+	while(line < end) {
+		uint8_t n = pgm_read_byte(image++);
+		if(n < 128) {
+			// n + 1 bytes follow as they are
+			++n;
+			memcpy_P(line, image, n);
+			image += n;
+		} else {
+			// the next byte repeated n - 125 times
+			n -= 125;
+			memset(line, pgm_read_byte(image++), n);
+		}
+		line += n;
+	}
+	return image;
+}
+
+void glcdDrawRleImagePgm(PGM_P image)
+{
+	// a full screen image starts the ring over
+	glcdSetYShift(0);
 #ifdef USE_FRAME_BUFFER
-	frameBuffer[x][yRoundDown] ^= (1 << yInByte);
+	for(uint8_t page = 0; page < FRAME_BUFFER_HEIGHT; ++page) {
+		image = unpackRlePage(image, frameBuffer[page]);
+	}
+	markAllDirty();
 #else
-	halGlcdSetAddress(x, yRoundDown);
-	uint8_t currVal = halGlcdReadData();
-	currVal ^= (0x01 << yInByte);
-	halGlcdSetAddress(x, yRoundDown);
-	halGlcdWriteData(currVal);
+	uint8_t line[SCREEN_WIDTH];
+	for(uint8_t page = 0; page < 8; ++page) {
+		image = unpackRlePage(image, line);
+		halGlcdWriteBurst(page, 0, line, SCREEN_WIDTH);
+	}
 #endif
 }
 
-void glcdDrawLine(const xy_point p1, const xy_point p2,
-					void (*drawPx)(const uint8_t, const uint8_t))
+void glcdBlitTilePgm(PGM_P tile, const int16_t worldX, const int16_t worldY)
 {
-	int8_t w = p2.x - p1.x;
-    int8_t h = p2.y - p1.y;
-    int8_t dx1 = 0, dy1 = 0, dx2 = 0, dy2 = 0 ;
-    if(w < 0) {
-    	dx1 = dx2 = -1;
-    }
-    else if(w > 0) {
-    	dx1 = dx2 = 1;    	
-    }
-    if(h < 0) {
-    	dy1 = -1;
-    } 
-    else if(h > 0) { 
-    	dy1 = 1;
-    }
-    int8_t longest = ABS(w);
-    int8_t shortest = ABS(h);
-    if (longest <= shortest) {
-        longest = ABS(h);
-        shortest = ABS(w);
-        if(h<0) {
-        	dy2 = -1;
-        } 
-        else if(h>0) {
-        	dy2 = 1;
-        }
-        dx2 = 0;            
-    }
-    int16_t error = longest / 2;
-    int8_t x = p1.x, y = p1.y;    
-    int8_t i;
-    for (i=0;i<=longest;i++) {
-        drawPx(x,y);
-        error += shortest;
-        if (error >= longest) {
-            error -= longest;
-            x += dx1;
-            y += dy1;
-        } else {
-            x += dx2;
-            y += dy2;
-        }
-    }
+	blitColumns((const uint8_t *)tile, 1, VIEW_X(worldX), VIEW_Y(worldY), 8);
 }
 
-void glcdDrawVertical(const uint8_t x,
-					void (*drawPx)(const uint8_t, const uint8_t))
+void glcdBlitBitmap(const uint8_t *bitmap, const uint8_t width, const uint8_t height, 
+					const uint8_t x, const uint8_t y)
 {
-	uint8_t y;
-	for(y = 0; y < 64; ++y) {
-		drawPx(x, y);
-	} 
+	for(uint8_t row = 0; row < height; row += 8) {
+		blitColumns(bitmap, 0, x, y + row, width);
+		bitmap += width;
+	}
 }
 
-void glcdDrawRect(const xy_point p1, const xy_point p2,
-				void (*drawPx)(const uint8_t, const uint8_t))
+static void blitColumns(const uint8_t *cols, const uint8_t inPgm, const int16_t x, const int16_t y, const uint8_t width)
 {
-	xy_point topLeft, topRight, bottomLeft, bottomRight;
-	topLeft = p1;
-	topRight.x = p2.x;
-	topRight.y = p1.y;
-	bottomLeft.x = p1.x;
-	bottomLeft.y = p2.y;
-	bottomRight = p2;
+	if(x > clipX1 || x + width <= clipX0 || y > clipY1 || y + 8 <= clipY0) {
+		return;
+	}
+	
+	// rows left after clipping at the top and bottom of the clip rectangle
+	uint8_t rows = 0xFF;
+	if(y < clipY0) {
+		rows = rowsFrom[clipY0 - y];
+	}
+	if(y + 7 > clipY1) {
+		rows &= rowsTo[clipY1 - y];
+	}
 	
-	--topRight.x;
-	glcdDrawLine(topLeft, topRight, drawPx);
-	++topRight.x;
+	uint8_t first = 0;
+	uint8_t last = width - 1;
+	if(x < clipX0) {
+		first = clipX0 - x;
+	}
+	if(x + last > clipX1) {
+		last = clipX1 - x;
+	}
+	uint8_t px = x + first;
+	uint8_t n = last - first + 1;
+	cols += first;
 	
-	--bottomRight.y;
-	glcdDrawLine(topRight, bottomRight, drawPx);
-	++bottomRight.y;
+	uint8_t row = RING_ROW(y);
+	uint8_t page = row / 8;
+	uint8_t shift = row % 8;
+	if(shift == 0 && rows == 0xFF) {
+		// the columns replace whole bytes of one page
+#ifdef USE_FRAME_BUFFER
+		uint8_t *line = &frameBuffer[page][px];
+#else
+		uint8_t line[SCREEN_WIDTH];
+#endif
+		if(inPgm) {
+			memcpy_P(line, cols, n);
+		}
+		else {
+			memcpy(line, cols, n);
+		}
+#ifdef USE_FRAME_BUFFER
+		markDirty(page, px, px + n - 1);
+#else
+		halGlcdWriteBurst(page, px, line, n);
+#endif
+		return;
+	}
 	
-	++bottomLeft.x;
-	glcdDrawLine(bottomRight, bottomLeft, drawPx);
-	--bottomLeft.x;
+	// otherwise each column is split over page and the next page of the ring
+	uint8_t nextPage = (page + 1) % (SCREEN_HEIGHT / 8);
+	uint16_t mask = rows * rowBit[shift];
+	for(uint8_t c = first; c <= last; ++c) {
+		uint8_t col = inPgm ? pgm_read_byte(cols) : *cols;
+		uint16_t img = (col * rowBit[shift]) & mask;
+		++cols;
+		maskByte(page, x + c, img, mask);
+		if(mask >> 8) {
+			maskByte(nextPage, x + c, img >> 8, mask >> 8);
+		}
+	}
 	
-	++topLeft.y;
-	glcdDrawLine(bottomLeft, topLeft, drawPx);
-	--topLeft.y;
+#ifdef USE_FRAME_BUFFER
+	markDirty(page, px, px + n - 1);
+	if(mask >> 8) {
+		markDirty(nextPage, px, px + n - 1);
+	}
+#endif
 }
 
-void glcdFillScreen(const uint8_t pattern)
+void glcdComposeScreen(void (*composePage)(const uint8_t page, uint8_t *line))
 {
-	
+	// the pages are composed in screen order
+	glcdSetYShift(0);
 #ifdef USE_FRAME_BUFFER
-	for(uint8_t j = 0; j < FRAME_BUFFER_HEIGHT; ++j) {
-		for(uint8_t i = 0; i < SCREEN_WIDTH; ++i) {
-			frameBuffer[i][j] = pattern;
-		}
+	for(uint8_t page = 0; page < FRAME_BUFFER_HEIGHT; ++page) {
+		composePage(page, frameBuffer[page]);
 	}
+	markAllDirty();
 #else
-	uint8_t x, y;
-	halGlcdSetAddress(0, 0);
-	for(y = 0; y < 8; ++y) {
-		halGlcdSetAddress(0, y);
-		for(x = 0; x < 128; ++x) {
-			halGlcdWriteData(pattern);
-		}
+	uint8_t line[SCREEN_WIDTH];
+	for(uint8_t page = 0; page < SCREEN_HEIGHT / 8; ++page) {
+		composePage(page, line);
+		halGlcdWriteBurst(page, 0, line, SCREEN_WIDTH);
 	}
 #endif
+}
 
+void glcdComposeSprite(uint8_t *line, const uint8_t page, const sprite *s, 
+					const uint8_t frame, const int16_t worldX, const int16_t worldY)
+{
+	int16_t x = VIEW_X(worldX);
+	int16_t y = VIEW_Y(worldY);
+	// row of the sprite top relative to the top of the page
+	int16_t top = y - page * 8;
+	if(top >= 8 || top + s->height <= 0) {
+		return;
+	}
+	if(x > clipX1 || x + s->width <= clipX0 || y > clipY1 || y + s->height <= clipY0) {
+		return;
+	}
+	
+	uint8_t rows = 0xFF;
+	if(y < clipY0) {
+		rows = rowsFrom[clipY0 - y];
+	}
+	if(y + 7 > clipY1) {
+		rows &= rowsTo[clipY1 - y];
+	}
+	
+	// a sprite starting above the page covers it with its lower bytes
+	uint8_t shift = top & 7;
+	uint16_t clip = rows * rowBit[shift];
+	uint8_t half = 0;
+	if(top < 0) {
+		clip >>= 8;
+		half = 2;
+	}
+	const uint8_t *col = s->data + half +
+		(uint16_t)(frame * 8 + shift) * s->width * SPRITE_COL_SIZE;
+	
+	uint8_t first = 0;
+	uint8_t last = s->width - 1;
+	if(x < clipX0) {
+		first = clipX0 - x;
+	}
+	if(x + last > clipX1) {
+		last = clipX1 - x;
+	}
+	col += first * SPRITE_COL_SIZE;
+	
+	for(uint8_t c = first; c <= last; ++c) {
+		uint8_t mask = pgm_read_byte(&col[1]) & clip;
+		line[x + c] = (line[x + c] & ~mask) | (pgm_read_byte(&col[0]) & clip);
+		col += SPRITE_COL_SIZE;
+	}
 }
 
-void glcdDrawArrayPgm(PGM_P array, uint16_t len)
+void glcdBlitSprite(const sprite *s, const uint8_t frame, const int16_t worldX, const int16_t worldY)
 {
-#ifdef USE_FRAME_BUFFER
-	uint16_t arrIdx = 0;
-	for(uint8_t j = 0; j < FRAME_BUFFER_HEIGHT; ++j) {
-		for(uint8_t i = 0; i < SCREEN_WIDTH; ++i) {
-			frameBuffer[i][j] = pgm_read_byte(&array[arrIdx++]);
-		}
+	int16_t x = VIEW_X(worldX);
+	int16_t y = VIEW_Y(worldY);
+	if(x > clipX1 || x + s->width <= clipX0 || y > clipY1 || y + s->height <= clipY0) {
+		return;
 	}
-#else
-	uint8_t arrIdx;
-	halGlcdSetAddress(0, 0);
-	for(uint8_t y = 0; y < 8; ++y) {
-		halGlcdSetAddress(0, y);
-		for(uint8_t x = 0; x < 128; ++x) {
-			halGlcdWriteData(pgm_read_byte(&array[arrIdx++]));
+	
+	// rows of the sprite left after clipping at the top and bottom of the clip rectangle
+	uint8_t rows = 0xFF;
+	if(y < clipY0) {
+		rows = rowsFrom[clipY0 - y];
+	}
+	if(y + 7 > clipY1) {
+		rows &= rowsTo[clipY1 - y];
+	}
+	
+	// the sprite covers rows of page, and of the next page of the ring 
+	// if it reaches past the bottom of page
+	uint8_t row = RING_ROW(y);
+	uint8_t page = row / 8;
+	uint8_t nextPage = (page + 1) % (SCREEN_HEIGHT / 8);
+	uint8_t shift = row % 8;
+	uint8_t lower = (shift + s->height > 8);
+	uint16_t clip = rows * rowBit[shift];
+	const uint8_t *col = s->data + 
+		(uint16_t)(frame * 8 + shift) * s->width * SPRITE_COL_SIZE;
+	
+	uint8_t first = 0;
+	uint8_t last = s->width - 1;
+	if(x < clipX0) {
+		first = clipX0 - x;
+	}
+	if(x + last > clipX1) {
+		last = clipX1 - x;
+	}
+	col += first * SPRITE_COL_SIZE;
+	
+	for(uint8_t c = first; c <= last; ++c) {
+		uint8_t px = x + c;
+		maskByte(page, px, pgm_read_byte(&col[0]) & clip, pgm_read_byte(&col[1]) & clip);
+		if(lower) {
+			maskByte(nextPage, px, pgm_read_byte(&col[2]) & (clip >> 8), pgm_read_byte(&col[3]) & (clip >> 8));
 		}
+		col += SPRITE_COL_SIZE;
+	}
+	
+#ifdef USE_FRAME_BUFFER
+	markDirty(page, x + first, x + last);
+	if(lower) {
+		markDirty(nextPage, x + first, x + last);
 	}
 #endif
 }
 
 void glcdSetYShift(uint8_t yshift)
 {
-	yShift = yshift;
-	halGlcdSetYShift(yshift);
+	yShift = yshift % SCREEN_HEIGHT;
+#ifndef USE_FRAME_BUFFER
+	halGlcdSetYShift(yShift);
+#endif
+}
+
+void glcdSetClip(const uint8_t x0, const uint8_t y0, const uint8_t x1, const uint8_t y1)
+{
+	clipX0 = x0;
+	clipY0 = y0;
+	clipX1 = (x1 < SCREEN_WIDTH) ? x1 : SCREEN_WIDTH - 1;
+	clipY1 = (y1 < SCREEN_HEIGHT) ? y1 : SCREEN_HEIGHT - 1;
+}
+
+void glcdResetClip(void)
+{
+	glcdSetClip(0, 0, SCREEN_WIDTH - 1, SCREEN_HEIGHT - 1);
+}
+
+void glcdSetViewport(const int16_t x, const int16_t y)
+{
+	viewX = x;
+	viewY = y;
+}
+
+void glcdScroll(const int8_t dy)
+{
+	glcdSetYShift(yShift + dy);
+	// the rows which scrolled in still hold the ones which scrolled out
+	if(dy >= SCREEN_HEIGHT || dy <= -SCREEN_HEIGHT) {
+		screenRowsClear(0, SCREEN_WIDTH - 1, 0, SCREEN_HEIGHT - 1);
+	}
+	else if(dy > 0) {
+		screenRowsClear(0, SCREEN_WIDTH - 1, SCREEN_HEIGHT - dy, SCREEN_HEIGHT - 1);
+	}
+	else if(dy < 0) {
+		screenRowsClear(0, SCREEN_WIDTH - 1, 0, -dy - 1);
+	}
+}
+
+void glcdScrollHorizontal(const int8_t dx)
+{
+	if(dx == 0) {
+		return;
+	}
+	// the display cannot scroll sideways, so every page is moved in memory
+	uint8_t n = (dx > 0) ? dx : -dx;
+	if(n > SCREEN_WIDTH) {
+		n = SCREEN_WIDTH;
+	}
+	uint8_t keep = SCREEN_WIDTH - n;
+	for(uint8_t page = 0; page < SCREEN_HEIGHT / 8; ++page) {
+#ifdef USE_FRAME_BUFFER
+		uint8_t *line = frameBuffer[page];
+#else
+		uint8_t line[SCREEN_WIDTH];
+		for(uint8_t x = 0; x < SCREEN_WIDTH; ++x) {
+			halGlcdSetAddress(x, page);
+			line[x] = halGlcdReadData();
+		}
+#endif
+		if(dx > 0) {
+			memmove(line, line + n, keep);
+			memset(line + keep, 0, n);
+		}
+		else {
+			memmove(line + n, line, keep);
+			memset(line, 0, n);
+		}
+#ifndef USE_FRAME_BUFFER
+		halGlcdWriteBurst(page, 0, line, SCREEN_WIDTH);
+#endif
+	}
+#ifdef USE_FRAME_BUFFER
+	markAllDirty();
+#endif
 }
 
 uint8_t glcdGetYShift(void)
@@ -232,80 +794,251 @@ uint8_t glcdGetYShift(void)
 void glcdDrawHorizontal(const uint8_t y,
 					void (*drawPx)(const uint8_t, const uint8_t))
 {
-	uint8_t x;
-	for(x = 0; x < 128; ++x) {
-		drawPx(x, y);
-	} 
+	PX_DISPATCH(drawPx, drawHorizontal, y);
+}
+
+void glcdDrawHorizontalOp(const uint8_t y, const glcd_rop_t rop)
+{
+	ROP_DISPATCH(rop, drawHorizontal, y);
 }
 
 void glcdFillRect(const xy_point p1, const xy_point p2,
 				void (*drawPx)(const uint8_t, const uint8_t))
 {
-	uint8_t x, y;
-	for(y = p1.y; y <= p2.y; ++y)
-	{
-		for(x = p1.x; x <= p2.x; ++x)
-		{
-			drawPx(x, y);
-		}
-	}
+	PX_DISPATCH(drawPx, fillRect, p1, p2);
+}
+
+void glcdFillRectOp(const xy_point p1, const xy_point p2, const glcd_rop_t rop)
+{
+	ROP_DISPATCH(rop, fillRect, p1, p2);
 }
 
 void glcdDrawChar(const char c, const xy_point p, const font* f,
 				void (*drawPx)(const uint8_t, const uint8_t))
 {
-	int16_t chOffset = (c - f->startChar); // c starts at the chOffset-th byte in our array
-	chOffset *=  f->width;
-	
-	uint8_t currByte, currBit;
-	for(currByte = 0; currByte < f->width; ++currByte) {
-		uint8_t chByte =  pgm_read_byte(&(f->font[chOffset + currByte]));
-		for(currBit = 0; currBit < 8; ++currBit) {
-			if((chByte & 0x01) != 0) {
-				drawPx(p.x + currByte, p.y + currBit);
-			}
-			chByte >>= 1;
-		}
-	}
+	PX_DISPATCH(drawPx, drawChar, c, p, f);
+}
+
+void glcdDrawCharOp(const char c, const xy_point p, const font* f, const glcd_rop_t rop)
+{
+	ROP_DISPATCH(rop, drawChar, c, p, f);
 }
 
 void glcdDrawText(const char *text, const xy_point p, const font* f,
 				void (*drawPx)(const uint8_t, const uint8_t))
 {
-	uint8_t txtIdx;
-	xy_point currPos = p;
-	for(txtIdx = 0; text[txtIdx] != '\0'; ++txtIdx) {
-		switch(text[txtIdx])
-		{
-		case '\n':
-			currPos.y += f->lineSpacing;
-			currPos.x = p.x;
-			break;
-		default:
-			glcdDrawChar(text[txtIdx], currPos, f, drawPx);
-			currPos.x += f->charSpacing;
-			break;
+	PX_DISPATCH(drawPx, drawText, text, p, f);
+}
+
+void glcdDrawTextOp(const char *text, const xy_point p, const font* f, const glcd_rop_t rop)
+{
+	ROP_DISPATCH(rop, drawText, text, p, f);
+}
+
+void glcdDrawTextPgm(PGM_P text, const xy_point p, const font* f,
+					void (*drawPx)(const uint8_t, const uint8_t))
+{
+	PX_DISPATCH(drawPx, drawTextPgm, text, p, f);
+}
+
+void glcdDrawTextPgmOp(PGM_P text, const xy_point p, const font* f, const glcd_rop_t rop)
+{
+	ROP_DISPATCH(rop, drawTextPgm, text, p, f);
+}
+
+static inline void maskByte(const uint8_t page, const uint8_t x, const uint8_t img, const uint8_t mask)
+{
+#ifdef USE_FRAME_BUFFER
+	frameBuffer[page][x] = (frameBuffer[page][x] & ~mask) | img;
+#else
+	halGlcdSetAddress(x, page);
+	uint8_t currVal = halGlcdReadData();
+	halGlcdSetAddress(x, page);
+	halGlcdWriteData((currVal & ~mask) | img);
+#endif
+}
+
+static uint8_t ropOf(void (*drawPx)(const uint8_t, const uint8_t), glcd_rop_t *rop)
+{
+	if(drawPx == glcdSetPixel) {
+		*rop = ROP_SET;
+	}
+	else if(drawPx == glcdClearPixel) {
+		*rop = ROP_CLEAR;
+	}
+	else if(drawPx == glcdInvertPixel) {
+		*rop = ROP_INVERT;
+	}
+	else {
+		return 0;
+	}
+	return 1;
+}
+
+static const uint8_t *glyphLookup(const char c, const font *f)
+{
+#ifdef USE_GLYPH_CACHE
+	if(f->width > GLYPH_CACHE_WIDTH) {
+		return NULL;
+	}
+	glyph_entry *entry = &glyphCache[(uint8_t)c % GLYPH_CACHE_SIZE];
+	if(entry->f != f || entry->c != c) {
+		memcpy_P(entry->columns, &(f->font[(int16_t)(c - f->startChar) * f->width]), f->width);
+		entry->f = f;
+		entry->c = c;
+	}
+	return entry->columns;
+#else
+	return NULL;
+#endif
+}
+
+#ifdef USE_FRAME_BUFFER
+static inline void markDirty(const uint8_t page, const uint8_t x0, const uint8_t x1)
+{
+	touchedByteCount += x1 - x0 + 1;
+	if(x0 < dirtyFrom[page]) {
+		dirtyFrom[page] = x0;
+	}
+	if(x1 > dirtyTo[page]) {
+		dirtyTo[page] = x1;
+	}
+}
+
+static void markAllDirty(void)
+{
+	touchedByteCount += sizeof(frameBuffer);
+	for(uint8_t j = 0; j < FRAME_BUFFER_HEIGHT; ++j) {
+		dirtyFrom[j] = 0;
+		dirtyTo[j] = SCREEN_WIDTH - 1;
+	}
+}
+
+static void takeDirtySpan(void)
+{
+	if(flushPage >= FRAME_BUFFER_HEIGHT) {
+		return;
+	}
+	flushCol = dirtyFrom[flushPage];
+	flushTo = dirtyTo[flushPage];
+	dirtyFrom[flushPage] = 0xFF;
+	dirtyTo[flushPage] = 0;
+}
+
+static void flushPageRegion(const uint8_t page, const uint8_t x0, const uint8_t x1)
+{
+	uint8_t from = (dirtyFrom[page] > x0) ? dirtyFrom[page] : x0;
+	uint8_t to = (dirtyTo[page] < x1) ? dirtyTo[page] : x1;
+	if(from > to) {
+		return;
+	}
+	
+	// the dirty span stays one span, so only an end of it can be taken off
+	if(from == dirtyFrom[page] && to == dirtyTo[page]) {
+		dirtyFrom[page] = 0xFF;
+		dirtyTo[page] = 0;
+	}
+	else if(from == dirtyFrom[page]) {
+		dirtyFrom[page] = to + 1;
+	}
+	else if(to == dirtyTo[page]) {
+		dirtyTo[page] = from - 1;
+	}
+	
+#ifdef USE_SHADOW_FLUSH
+	if(shadowValid) {
+		while(from <= to && frameBuffer[page][from] == shadowBuffer[page][from]) {
+			++from;
+		}
+		while(to > from && frameBuffer[page][to] == shadowBuffer[page][to]) {
+			--to;
+		}
+		if(from > to) {
+			return;
 		}
 	}
+#endif
+	flushSpan(page, from, to);
 }
 
-void  glcdDrawTextPgm(PGM_P text, const xy_point p, const font* f,
-					void (*drawPx)(const uint8_t, const uint8_t))
+static uint8_t runEnd(const uint8_t budget)
 {
-	uint8_t txtIdx;
-	xy_point currPos = p;
-	uint8_t currChar;
-	for(txtIdx = 0; ( currChar = pgm_read_byte(&(text[txtIdx])) ) != '\0'; ++txtIdx) {
-		switch(currChar)
-		{
-		case '\n':
-			currPos.y += f->lineSpacing;
-			currPos.x = p.x;
-			break;
-		default:
-			glcdDrawChar(currChar, currPos, f, drawPx);
-			currPos.x += f->charSpacing;
-			break;
+	uint8_t last = flushTo;
+	if(last - flushCol >= budget) {
+		last = flushCol + budget - 1;
+	}
+#ifdef USE_SHADOW_FLUSH
+	if(!shadowValid) {
+		return last;
+	}
+	// extend the run over short gaps of unchanged bytes
+	uint8_t end = flushCol;
+	uint8_t gap = 0;
+	for(uint8_t i = flushCol + 1; i <= last && gap < SHADOW_MERGE_GAP + 1; ++i) {
+		if(frameBuffer[flushPage][i] != shadowBuffer[flushPage][i]) {
+			end = i;
+			gap = 0;
+		}
+		else {
+			++gap;
 		}
 	}
+	return end;
+#else
+	return last;
+#endif
+}
+
+static void flushSpan(const uint8_t page, const uint8_t from, const uint8_t to)
+{
+	const uint8_t *line = &frameBuffer[page][from];
+	uint8_t n = to - from + 1;
+	uint8_t crossing = (from < SCREEN_WIDTH / 2 && to >= SCREEN_WIDTH / 2);
+	
+#ifdef USE_SHADOW_FLUSH
+	memcpy(&shadowBuffer[page][from], line, n);
+#endif
+	flushByteCount += n;
+	
+	if(crossing && interleaveFlush) {
+		uint8_t nLeft = SCREEN_WIDTH / 2 - from;
+		// both controllers share one address command if they start at the same column
+		flushAddressCount += (from == 0) ? 1 : 2;
+		halGlcdWriteInterleaved(page, from, line, nLeft, 0, line + nLeft, n - nLeft);
+		// the right controller is written last, unless the left half is longer
+		panelPage = (n - nLeft >= nLeft) ? page : 0xFF;
+		panelCol = to + 1;
+		return;
+	}
+	
+	if(page != panelPage || from != panelCol) {
+		++flushAddressCount; // the hal only moves the address if needed
+	}
+	if(crossing) {
+		++flushAddressCount; // the hal moves to the second controller on its own
+	}
+	halGlcdWriteBurst(page, from, line, n);
+	panelPage = page;
+	panelCol = to + 1;
 }
+
+static void benchFullFlush(const uint8_t interleave, glcd_flush_bench *result)
+{
+	interleaveFlush = interleave;
+#ifdef USE_SHADOW_FLUSH
+	shadowValid = 0; // send every byte
+#endif
+	markAllDirty();
+	
+	uint32_t busCycles = halGlcdGetBusCycles();
+	TCCR1A = 0;
+	TCNT1 = 0;
+	TCCR1B = (1 << CS11) | (1 << CS10);
+	glcdFlushFramebuffer();
+	TCCR1B = 0;
+	result->timerTicks = TCNT1;
+	result->busCycles = halGlcdGetBusCycles() - busCycles;
+	
+	interleaveFlush = 1;
+}
+#endif
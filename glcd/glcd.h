@@ -1,21 +1,117 @@
 #include <avr/io.h>
 
 #include "font/font.h"
+#include "sprite/sprite.h"
 
 #define SCREEN_WIDTH 128
 #define SCREEN_HEIGHT 64
 
+/**
+ * @brief When this define exists a framebuffer is used.
+ * 
+ * If the define is deleted, the code defaults back to direct writing,
+ * which saves the framebuffer and its shadow. Drawing that way is slow, 
+ * and very much not recomended, screens should be composed with 
+ * glcdComposeScreen() instead.
+ */
+#define USE_FRAME_BUFFER
+
 // 2D 8bit unsigned cartesian points
 typedef struct xy_point_t {
 	uint8_t x, y;
 } xy_point;
 
 /**
- * @brief Flushes entire framebuffer to the screen 
+ * @brief How drawn pixels are combined with what is already there.
+ *
+ * The functions taking a raster operation use drawing code specialized
+ * for it. The ones taking a pixel function map glcdSetPixel, glcdClearPixel
+ * and glcdInvertPixel to these, and call back any other function per pixel.
+ */
+typedef enum {
+	ROP_SET,
+	ROP_CLEAR,
+	ROP_INVERT
+} glcd_rop_t;
+
+// cost of a full frame flush, as measured by glcdBenchmarkFlush
+typedef struct glcd_flush_bench_t {
+	uint32_t busCycles;	// enable pulses sent to the display
+	uint16_t timerTicks;	// Timer1 ticks at prescalar 64, i.e. 4us at 16MHz
+} glcd_flush_bench;
+
+/**
+ * @brief Flushes the framebuffer to the screen 
  * if the framebuffer flag was set during compilation.
+ *
+ * Only the column spans of each page which were drawn to
+ * since the last flush are considered. With the shadow flush
+ * enabled, only the bytes differing from the last sent frame
+ * are sent.
  */
 void glcdFlushFramebuffer(void);
 
+/**
+ * @brief Sends what was drawn inside the rectangle from (x0, y0) to (x1, y1)
+ * in screen coordinates right away, and nothing else.
+ *
+ * Whole framebuffer pages are sent, limited to the columns x0 to x1 and to
+ * what changed. The display start line is left to the next full flush, and
+ * a running flush still sends what it already took over.
+ */
+void glcdFlushRegion(const uint8_t x0, const uint8_t y0, const uint8_t x1, const uint8_t y1);
+
+/**
+ * @brief Starts a flush which is sent in slices by glcdFlushStep().
+ *
+ * Starting a flush while another one is running restarts it, nothing
+ * drawn in between is lost.
+ */
+void glcdFlushBegin(void);
+
+/**
+ * @brief Sends the next slice of a flush started by glcdFlushBegin().
+ *
+ * Can be called from the idle loop or from a timer interrupt, as long
+ * as nothing else talks to the display meanwhile. Drawing while a flush
+ * runs is allowed, but the screen may show a partially drawn frame.
+ * @param budget Maximum number of data bytes to send.
+ * @return 1 if the flush is complete, 0 if there is more to send.
+ */
+uint8_t glcdFlushStep(uint8_t budget);
+
+/**
+ * @brief Returns 1 if no flush is running, so the framebuffer can be redrawn.
+ */
+uint8_t glcdFlushComplete(void);
+
+/**
+ * @brief Returns how many data bytes the last flush sent to the screen.
+ */
+uint16_t glcdGetFlushByteCount(void);
+
+/**
+ * @brief Returns how many address commands the last flush sent to the screen.
+ */
+uint8_t glcdGetFlushAddressCount(void);
+
+/**
+ * @brief Returns how many framebuffer bytes were drawn to for the frame
+ * the last flush was started with.
+ *
+ * A byte drawn to several times counts several times. Always 0 without
+ * the framebuffer.
+ */
+uint16_t glcdGetTouchedByteCount(void);
+
+/**
+ * @brief Sends the full framebuffer twice, once controller after controller
+ * and once alternating between the controllers, and measures both.
+ *
+ * Uses Timer1, which has to be otherwise unused.
+ */
+void glcdBenchmarkFlush(glcd_flush_bench *sequential, glcd_flush_bench *interleaved);
+
 void glcdInit(void);
 
 void glcdSetPixel(const uint8_t x, const uint8_t y);
@@ -27,36 +123,173 @@ void glcdInvertPixel(const uint8_t x, const uint8_t y);
 void glcdDrawLine(const xy_point p1, const xy_point p2,
 				void (*drawPx)(const uint8_t, const uint8_t));
 
+void glcdDrawLineOp(const xy_point p1, const xy_point p2, const glcd_rop_t rop);
+
 void glcdDrawRect(const xy_point p1, const xy_point p2,
 				void (*drawPx)(const uint8_t, const uint8_t));
 
+void glcdDrawRectOp(const xy_point p1, const xy_point p2, const glcd_rop_t rop);
+
 void glcdFillScreen(const uint8_t pattern);
 
+/**
+ * @brief Fills the framebuffer and the screen with pattern right away.
+ *
+ * Both display controllers are written at once, which takes half the
+ * bus time of flushing a filled framebuffer. Cancels a running flush.
+ */
+void glcdClearScreen(const uint8_t pattern);
+
+/**
+ * @brief Sets the framebuffer row shown in the top row of the screen.
+ *
+ * The framebuffer is a ring of rows, so everything drawn scrolls up 
+ * by yshift rows. Drawing still takes screen coordinates. With the 
+ * framebuffer, the display follows once the next flush is complete.
+ */
 void glcdSetYShift(uint8_t yshift);
 
 uint8_t glcdGetYShift(void);
 
+/**
+ * @brief Scrolls the screen contents up by dy rows, or down for negative dy.
+ *
+ * Moves the display start line instead of the pixels, so only the rows 
+ * scrolling in have to be drawn and sent. They are cleared.
+ */
+void glcdScroll(const int8_t dy);
+
+/**
+ * @brief Scrolls the screen contents left by dx columns, or right for negative dx.
+ *
+ * The display has no horizontal start line, so the pixels are moved in 
+ * the framebuffer, or read back and written again without it. The columns
+ * scrolling in are cleared. Everything that changed is sent again.
+ */
+void glcdScrollHorizontal(const int8_t dx);
+
+/**
+ * @brief Limits all drawing to the rectangle from (x0, y0) to (x1, y1) 
+ * in screen coordinates, both corners included.
+ *
+ * Lines, rectangles, text and sprites are clipped against it as whole 
+ * spans, so callers need no bounds checks of their own. Filling, clearing
+ * and scrolling the screen and full screen images ignore it.
+ */
+void glcdSetClip(const uint8_t x0, const uint8_t y0, const uint8_t x1, const uint8_t y1);
+
+/**
+ * @brief Sets the clip rectangle back to the whole screen.
+ */
+void glcdResetClip(void);
+
+/**
+ * @brief Sets the world coordinates shown in the top left corner of the screen.
+ *
+ * All drawing functions take world coordinates, which are moved by the 
+ * viewport. Pixel functions other than the glcd ones passed as drawPx 
+ * are called with screen coordinates.
+ */
+void glcdSetViewport(const int16_t x, const int16_t y);
+
 void glcdDrawVertical(const uint8_t x,
 					void (*drawPx)(const uint8_t, const uint8_t));
 
+void glcdDrawVerticalOp(const uint8_t x, const glcd_rop_t rop);
+
 void glcdDrawHorizontal(const uint8_t y,
 					void (*drawPx)(const uint8_t, const uint8_t));
 
+void glcdDrawHorizontalOp(const uint8_t y, const glcd_rop_t rop);
+
+/**
+ * @brief Fills the rectangle from p1 to p2, both included.
+ *
+ * With one of the glcd pixel functions, or through glcdFillRectOp, the
+ * rectangle is clipped to the clip rectangle and written a column byte at a time.
+ */
 void glcdFillRect(const xy_point p1, const xy_point p2,
 				void (*drawPx)(const uint8_t, const uint8_t));
+
+void glcdFillRectOp(const xy_point p1, const xy_point p2, const glcd_rop_t rop);
 				
 void glcdDrawChar(const char c, const xy_point p, const font* f,
 				void (*drawPx)(const uint8_t, const uint8_t));
+
+void glcdDrawCharOp(const char c, const xy_point p, const font* f, const glcd_rop_t rop);
 				
 void glcdDrawText(const char *text, const xy_point p, const font* f,
 				void (*drawPx)(const uint8_t, const uint8_t));
+
+void glcdDrawTextOp(const char *text, const xy_point p, const font* f, const glcd_rop_t rop);
 				
 void glcdDrawTextPgm(PGM_P text, const xy_point p, const font* f,
 					void (*drawPx)(const uint8_t, const uint8_t));
 
+void glcdDrawTextPgmOp(PGM_P text, const xy_point p, const font* f, const glcd_rop_t rop);
+
+/**
+ * @brief Draws one frame of a sprite with its top left corner at (worldX, worldY).
+ *
+ * Pixels inside the mask are replaced by the image, the ones outside are
+ * left as they are. The sprite may lie partially or fully outside the 
+ * clip rectangle.
+ */
+void glcdBlitSprite(const sprite *s, const uint8_t frame, const int16_t worldX, const int16_t worldY);
+
+/**
+ * @brief Draws an 8x8 tile with its top left corner at (worldX, worldY).
+ *
+ * The tile is 8 column bytes in progmem, bit 0 being the top row, and
+ * replaces everything below it. Tiles on a page boundary are copied as
+ * they are, others are shifted into the two pages they cover.
+ */
+void glcdBlitTilePgm(PGM_P tile, const int16_t worldX, const int16_t worldY);
+
+/**
+ * @brief Draws a bitmap in RAM with its top left corner at (x, y) in screen 
+ * coordinates, for overlays which stay in place while the viewport moves.
+ *
+ * The bitmap is stored page by page like the framebuffer, width column bytes
+ * per page, and replaces everything below it. height is a multiple of 8.
+ * Pages which line up with the framebuffer pages are copied as they are.
+ */
+void glcdBlitBitmap(const uint8_t *bitmap, const uint8_t width, const uint8_t height, 
+					const uint8_t x, const uint8_t y);
+
+/**
+ * @brief Sends the whole screen page by page, each composed by composePage 
+ * right before it is sent.
+ *
+ * composePage fills line with the SCREEN_WIDTH column bytes of the given 
+ * screen page, bit 0 being the top row. Only one page is held in memory 
+ * at a time. With the framebuffer, the pages are composed into it instead.
+ */
+void glcdComposeScreen(void (*composePage)(const uint8_t page, uint8_t *line));
+
+/**
+ * @brief Draws the part of a sprite frame which covers one screen page into 
+ * the line of that page, for use in a composePage function.
+ *
+ * Like glcdBlitSprite(), takes world coordinates and clips against the 
+ * clip rectangle.
+ */
+void glcdComposeSprite(uint8_t *line, const uint8_t page, const sprite *s, 
+					const uint8_t frame, const int16_t worldX, const int16_t worldY);
+
 /**
  * @brief Flushes an entire array size of 1024 * 8 to the screen.
  *
  * Writes to the framebuffer if enabled. If not, writes directly.
  */			
 void glcdDrawArrayPgm(PGM_P array, uint16_t len); 					
+
+/**
+ * @brief Draws a full screen image packed by tools/rle_encode.
+ *
+ * The image is the glcdDrawArrayPgm() layout, packed page by page. Each
+ * control byte n < 128 is followed by n + 1 bytes copied as they are, 
+ * n >= 128 by one byte repeated n - 125 times. Runs never cross a page,
+ * so without the framebuffer each page is unpacked and sent on its own.
+ */
+void glcdDrawRleImagePgm(PGM_P image);
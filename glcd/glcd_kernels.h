@@ -0,0 +1,371 @@
+/**
+ * @brief Drawing kernels, included by glcd.c once per raster operation.
+ *
+ * Before including, define:
+ * KERNEL(name)	appends the raster operation to a kernel name.
+ * KERNEL_BYTE(b, m)	combines the bits in mask m with byte b, for the raster operations.
+ * KERNEL_ARGS		extra parameters of every kernel, starting with a comma.
+ * KERNEL_PASS		the names of those extra parameters, starting with a comma.
+ * If KERNEL_BYTE is not defined, KERNEL_PX(x, y) has to be defined to draw one
+ * pixel in screen coordinates, inside the clip rectangle.
+ *
+ * The kernels taking xy_point or a single coordinate take world coordinates
+ * and move them by the viewport. The helpers below work in screen coordinates.
+ *
+ * All the definitions are undefined again at the end of the file.
+ */
+
+#ifdef KERNEL_BYTE
+static inline void KERNEL(px)(const int16_t x, const int16_t y)
+{
+	if(x < clipX0 || x > clipX1 || y < clipY0 || y > clipY1) {
+		return;
+	}
+	uint8_t row = RING_ROW(y);
+	uint8_t page = row / 8;
+#ifdef USE_FRAME_BUFFER
+	KERNEL_BYTE(frameBuffer[page][x], rowBit[row % 8]);
+	markDirty(page, x, x);
+#else
+	halGlcdSetAddress(x, page);
+	uint8_t currVal = halGlcdReadData();
+	KERNEL_BYTE(currVal, rowBit[row % 8]);
+	halGlcdSetAddress(x, page);
+	halGlcdWriteData(currVal);
+#endif
+}
+
+// applies mask to a single byte, for callers which mark the dirty span themselves
+static inline void KERNEL(byte)(const uint8_t page, const uint8_t x, const uint8_t mask)
+{
+#ifdef USE_FRAME_BUFFER
+	KERNEL_BYTE(frameBuffer[page][x], mask);
+#else
+	if(mask == 0) {
+		return;
+	}
+	halGlcdSetAddress(x, page);
+	uint8_t currVal = halGlcdReadData();
+	KERNEL_BYTE(currVal, mask);
+	halGlcdSetAddress(x, page);
+	halGlcdWriteData(currVal);
+#endif
+}
+
+static void KERNEL(span)(const uint8_t page, const uint8_t x0, const uint8_t x1, const uint8_t mask)
+{
+#ifdef USE_FRAME_BUFFER
+	uint8_t *col = &frameBuffer[page][x0];
+	for(uint8_t n = x1 - x0 + 1; n > 0; --n) {
+		KERNEL_BYTE(*col, mask);
+		++col;
+	}
+	markDirty(page, x0, x1);
+#else
+	for(uint8_t x = x0; x <= x1; ++x) {
+		halGlcdSetAddress(x, page);
+		uint8_t currVal = halGlcdReadData();
+		KERNEL_BYTE(currVal, mask);
+		halGlcdSetAddress(x, page);
+		halGlcdWriteData(currVal);
+	}
+#endif
+}
+
+// the framebuffer rows r0 to r1 of the columns x0 to x1. The first and
+// last page are masked, the ones in between are written whole.
+static void KERNEL(rows)(const uint8_t x0, const uint8_t x1, const uint8_t r0, const uint8_t r1)
+{
+	uint8_t page = r0 / 8;
+	uint8_t lastPage = r1 / 8;
+	uint8_t mask = rowsFrom[r0 % 8];
+	for(; page < lastPage; ++page) {
+		KERNEL(span)(page, x0, x1, mask);
+		mask = 0xFF;
+	}
+	KERNEL(span)(page, x0, x1, mask & rowsTo[r1 % 8]);
+}
+
+// the screen rows y0 to y1 of the columns x0 to x1, which have to be on screen
+static void KERNEL(screenRows)(const uint8_t x0, const uint8_t x1, const uint8_t y0, const uint8_t y1)
+{
+	// the rows follow each other in the ring, unless they wrap around its end
+	uint8_t r0 = RING_ROW(y0);
+	uint8_t r1 = r0 + (y1 - y0);
+	if(r1 >= SCREEN_HEIGHT) {
+		KERNEL(rows)(x0, x1, r0, SCREEN_HEIGHT - 1);
+		r0 = 0;
+		r1 -= SCREEN_HEIGHT;
+	}
+	KERNEL(rows)(x0, x1, r0, r1);
+}
+
+// the block from (x0, y0) to (x1, y1) in screen coordinates, clipped
+// to the clip rectangle. Horizontal and vertical lines are blocks too.
+static void KERNEL(block)(int16_t x0, int16_t x1, int16_t y0, int16_t y1)
+{
+	if(x0 < clipX0) {
+		x0 = clipX0;
+	}
+	if(x1 > clipX1) {
+		x1 = clipX1;
+	}
+	if(y0 < clipY0) {
+		y0 = clipY0;
+	}
+	if(y1 > clipY1) {
+		y1 = clipY1;
+	}
+	if(x1 < x0 || y1 < y0) {
+		return;
+	}
+	KERNEL(screenRows)(x0, x1, y0, y1);
+}
+
+#define KERNEL_PX(x, y) KERNEL(px)(x, y)
+#endif
+
+static void KERNEL(drawLine)(const xy_point p1, const xy_point p2 KERNEL_ARGS)
+{
+	int16_t x1 = VIEW_X(p1.x), y1 = VIEW_Y(p1.y);
+	int16_t x2 = VIEW_X(p2.x), y2 = VIEW_Y(p2.y);
+#ifdef KERNEL_BYTE
+	// maze walls are all axis aligned, those are drawn a byte at a time
+	if(y1 == y2) {
+		if(x1 <= x2) {
+			KERNEL(block)(x1, x2, y1, y1);
+		}
+		else {
+			KERNEL(block)(x2, x1, y1, y1);
+		}
+		return;
+	}
+	if(x1 == x2) {
+		if(y1 <= y2) {
+			KERNEL(block)(x1, x1, y1, y2);
+		}
+		else {
+			KERNEL(block)(x1, x1, y2, y1);
+		}
+		return;
+	}
+#endif
+	int16_t w = x2 - x1;
+	int16_t h = y2 - y1;
+	int8_t dx1 = 0, dy1 = 0, dx2 = 0, dy2 = 0;
+	if(w < 0) {
+		dx1 = dx2 = -1;
+	}
+	else if(w > 0) {
+		dx1 = dx2 = 1;
+	}
+	if(h < 0) {
+		dy1 = -1;
+	}
+	else if(h > 0) {
+		dy1 = 1;
+	}
+	int16_t longest = ABS(w);
+	int16_t shortest = ABS(h);
+	if(longest <= shortest) {
+		longest = ABS(h);
+		shortest = ABS(w);
+		if(h < 0) {
+			dy2 = -1;
+		}
+		else if(h > 0) {
+			dy2 = 1;
+		}
+		dx2 = 0;
+	}
+	int16_t error = longest / 2;
+	int16_t x = x1, y = y1;
+	for(int16_t i = 0; i <= longest; ++i) {
+		KERNEL_PX(x, y);
+		error += shortest;
+		if(error >= longest) {
+			error -= longest;
+			x += dx1;
+			y += dy1;
+		}
+		else {
+			x += dx2;
+			y += dy2;
+		}
+	}
+}
+
+static void KERNEL(drawVertical)(const uint8_t x KERNEL_ARGS)
+{
+	int16_t sx = VIEW_X(x);
+#ifdef KERNEL_BYTE
+	KERNEL(block)(sx, sx, 0, SCREEN_HEIGHT - 1);
+#else
+	for(int16_t y = clipY0; y <= clipY1; ++y) {
+		KERNEL_PX(sx, y);
+	}
+#endif
+}
+
+static void KERNEL(drawHorizontal)(const uint8_t y KERNEL_ARGS)
+{
+	int16_t sy = VIEW_Y(y);
+#ifdef KERNEL_BYTE
+	KERNEL(block)(0, SCREEN_WIDTH - 1, sy, sy);
+#else
+	for(int16_t x = clipX0; x <= clipX1; ++x) {
+		KERNEL_PX(x, sy);
+	}
+#endif
+}
+
+static void KERNEL(drawRect)(const xy_point p1, const xy_point p2 KERNEL_ARGS)
+{
+	xy_point topLeft, topRight, bottomLeft, bottomRight;
+	topLeft = p1;
+	topRight.x = p2.x;
+	topRight.y = p1.y;
+	bottomLeft.x = p1.x;
+	bottomLeft.y = p2.y;
+	bottomRight = p2;
+
+	--topRight.x;
+	KERNEL(drawLine)(topLeft, topRight KERNEL_PASS);
+	++topRight.x;
+
+	--bottomRight.y;
+	KERNEL(drawLine)(topRight, bottomRight KERNEL_PASS);
+	++bottomRight.y;
+
+	++bottomLeft.x;
+	KERNEL(drawLine)(bottomRight, bottomLeft KERNEL_PASS);
+	--bottomLeft.x;
+
+	++topLeft.y;
+	KERNEL(drawLine)(bottomLeft, topLeft KERNEL_PASS);
+	--topLeft.y;
+}
+
+static void KERNEL(fillRect)(const xy_point p1, const xy_point p2 KERNEL_ARGS)
+{
+#ifdef KERNEL_BYTE
+	KERNEL(block)(VIEW_X(p1.x), VIEW_X(p2.x), VIEW_Y(p1.y), VIEW_Y(p2.y));
+#else
+	int16_t x, y;
+	for(y = VIEW_Y(p1.y); y <= VIEW_Y(p2.y); ++y)
+	{
+		for(x = VIEW_X(p1.x); x <= VIEW_X(p2.x); ++x)
+		{
+			KERNEL_PX(x, y);
+		}
+	}
+#endif
+}
+
+static void KERNEL(drawChar)(const char c, const xy_point p, const font* f KERNEL_ARGS)
+{
+	int16_t sx = VIEW_X(p.x);
+	int16_t sy = VIEW_Y(p.y);
+#ifdef KERNEL_BYTE
+	// every font column lands in one byte, or two if the glyph crosses a page
+	uint8_t height = f->height;
+	if(sx > clipX1 || sy > clipY1 || sx + f->width <= clipX0 || sy + height <= clipY0) {
+		return;
+	}
+	uint8_t rows = rowsTo[height - 1];
+	if(sy < clipY0) {
+		rows &= rowsFrom[clipY0 - sy];
+	}
+	if(sy + height - 1 > clipY1) {
+		rows &= rowsTo[clipY1 - sy];
+	}
+	uint8_t first = (sx < clipX0) ? clipX0 - sx : 0;
+	uint8_t last = f->width - 1;
+	if(sx + last > clipX1) {
+		last = clipX1 - sx;
+	}
+
+	uint8_t row = RING_ROW(sy);
+	uint8_t page = row / 8;
+	uint8_t nextPage = (page + 1) % (SCREEN_HEIGHT / 8);
+	uint8_t lower = (row % 8 + height > 8);
+	// shifting is a loop on the avr, multiplying is not
+	uint8_t shift = rowBit[row % 8];
+
+	const uint8_t *glyph = glyphLookup(c, f);
+	const uint8_t *pgm = &(f->font[(int16_t)(c - f->startChar) * f->width]);
+	for(uint8_t i = first; i <= last; ++i) {
+		uint8_t chByte = (glyph != NULL) ? glyph[i] : pgm_read_byte(&pgm[i]);
+		uint16_t column = (chByte & rows) * shift;
+		KERNEL(byte)(page, sx + i, (uint8_t)column);
+		if(lower) {
+			KERNEL(byte)(nextPage, sx + i, column >> 8);
+		}
+	}
+#ifdef USE_FRAME_BUFFER
+	markDirty(page, sx + first, sx + last);
+	if(lower) {
+		markDirty(nextPage, sx + first, sx + last);
+	}
+#endif
+#else
+	int16_t chOffset = (c - f->startChar); // c starts at the chOffset-th byte in our array
+	chOffset *=  f->width;
+
+	uint8_t currByte, currBit;
+	for(currByte = 0; currByte < f->width; ++currByte) {
+		uint8_t chByte =  pgm_read_byte(&(f->font[chOffset + currByte]));
+		for(currBit = 0; currBit < 8; ++currBit) {
+			if((chByte & 0x01) != 0) {
+				KERNEL_PX(sx + currByte, sy + currBit);
+			}
+			chByte >>= 1;
+		}
+	}
+#endif
+}
+
+static void KERNEL(drawText)(const char *text, const xy_point p, const font* f KERNEL_ARGS)
+{
+	uint8_t txtIdx;
+	xy_point currPos = p;
+	for(txtIdx = 0; text[txtIdx] != '\0'; ++txtIdx) {
+		switch(text[txtIdx])
+		{
+		case '\n':
+			currPos.y += f->lineSpacing;
+			currPos.x = p.x;
+			break;
+		default:
+			KERNEL(drawChar)(text[txtIdx], currPos, f KERNEL_PASS);
+			currPos.x += f->charSpacing;
+			break;
+		}
+	}
+}
+
+static void KERNEL(drawTextPgm)(PGM_P text, const xy_point p, const font* f KERNEL_ARGS)
+{
+	uint8_t txtIdx;
+	xy_point currPos = p;
+	uint8_t currChar;
+	for(txtIdx = 0; ( currChar = pgm_read_byte(&(text[txtIdx])) ) != '\0'; ++txtIdx) {
+		switch(currChar)
+		{
+		case '\n':
+			currPos.y += f->lineSpacing;
+			currPos.x = p.x;
+			break;
+		default:
+			KERNEL(drawChar)(currChar, currPos, f KERNEL_PASS);
+			currPos.x += f->charSpacing;
+			break;
+		}
+	}
+}
+
+#undef KERNEL
+#undef KERNEL_BYTE
+#undef KERNEL_PX
+#undef KERNEL_ARGS
+#undef KERNEL_PASS
@@ -2,6 +2,46 @@
 
 #include "../utils/utils.h"
 
+/**
+ * @brief When this define exists, the bus is driven with fixed delays
+ * computed from F_CPU and the KS0108 timing instead of polling the busy flag.
+ *
+ * Saves the status read before every access and the 32 bit nop loops.
+ * Off by default: the busy time depends on the clock of the module, so 
+ * GLCD_FCLK_HZ has to be checked against the module before enabling it.
+ */
+//#define HAL_GLCD_TIMED_BUS
+
+#ifdef HAL_GLCD_TIMED_BUS
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+/**
+ * @brief Lowest clock the KS0108 controllers of the module run at, in Hz.
+ *
+ * The KS0108B datasheet gives 250 kHz as the typical fCLK. Modules with 
+ * a slower oscillator need a lower value, or the timed bus drops bytes.
+ */
+#ifndef GLCD_FCLK_HZ
+#define GLCD_FCLK_HZ 250000UL
+#endif
+
+// KS0108 bus timing in nanoseconds
+#define T_AS_NS 140 	// RS, RW and CS setup before E rises
+#define T_WH_NS 450 	// E high pulse width
+#define T_RST_NS 10000 	// reset released to the first command
+
+// E falling to the next E rising on the same controller. The datasheet
+// gives the busy time as at most 3 / fCLK, plus a quarter for tolerance.
+// 15us at 250 kHz.
+#define T_BUSY_NS (3000000000UL / GLCD_FCLK_HZ * 5 / 4)
+
+// nanoseconds to cpu cycles, rounded up
+#define NS_TO_CYCLES(ns) ((F_CPU / 1000UL * (ns) + 999999UL) / 1000000UL)
+#define DELAY_NS(ns) __builtin_avr_delay_cycles(NS_TO_CYCLES(ns))
+#endif
+
 #define CTRLRB (0x00)
 #define CTRLR1 (0x01)
 #define CTRLR2 (0x02)
@@ -45,9 +85,14 @@ static uint8_t currCtrlr;
 static uint8_t xDeviceSpace;
 static uint8_t yDeviceSpace;
 
+// enable pulses sent so far
+static uint32_t busCycles;
+
 // delay loops using inline assembler
+#ifndef HAL_GLCD_TIMED_BUS
 static void nops3(void);
 static void nops8(void);
+#endif
 
 // increments the saved Y position (yDeviceSpace),
 // and wraps if the number has gone to the next controller
@@ -56,6 +101,9 @@ static void updateY(void);
 // bit modification helper functions
 static void halGlcdSetResetBit(void);
 static void halGlcdSetEnableBit(void);
+// like halGlcdSetEnableBit, but without waiting for the controller to 
+// finish a previous write. Only for alternating between the controllers.
+static void halGlcdSetEnableBitShort(void);
 static void halGlcdClearEnableBit(void);
 static void setRW(uint8_t rw);
 static void setRS(uint8_t rs);
@@ -106,7 +154,9 @@ void halGlcdSetYShift(uint8_t y)
 {
 	uint8_t oldCtrlr = currCtrlr;
 	halGlcdCtrlWriteCmd(CTRLRB, z_data(y)); 
-	currCtrlr = oldCtrlr;
+	// select the old controller again, so that a burst continuing 
+	// at the current address does not go to both controllers
+	halGlcdCtrlSelect(oldCtrlr);
 }
 
 uint8_t halGlcdWriteData(const uint8_t data)
@@ -116,6 +166,118 @@ uint8_t halGlcdWriteData(const uint8_t data)
 	return 0;
 }
 
+uint8_t halGlcdWriteBurst(const uint8_t page, const uint8_t col, 
+					const uint8_t *buf, uint8_t n)
+{
+	uint8_t ctrlr = ((col < 64) ? CTRLR2 : CTRLR1);
+	if(ctrlr != currCtrlr || page != xDeviceSpace || (col % 64) != yDeviceSpace) {
+		halGlcdSetAddress(col, page);
+	}
+	
+	while(n > 0) {
+		uint8_t chunk = 64 - yDeviceSpace;
+		if(chunk > n) {
+			chunk = n;
+		}
+		n -= chunk;
+		
+		halGlcdCtrlBusyWait(currCtrlr);
+		setRS(DATA);
+		setRW(WRITE);
+		// the enable cycle is longer than the time the controller 
+		// stays busy after a data write, so there is no need to poll
+		for(uint8_t i = 0; i < chunk; ++i) {
+			DATABUS = *buf++;
+			halGlcdSetEnableBit();
+			halGlcdClearEnableBit();
+		}
+		
+		yDeviceSpace += chunk - 1;
+		updateY(); // moves on to the other controller at its last column
+	}
+	return 0;
+}
+
+uint8_t halGlcdWriteBroadcast(const uint8_t page, const uint8_t col, 
+					const uint8_t data, uint8_t n)
+{
+	halGlcdCtrlSetAddress(CTRLRB, page, col);
+	halGlcdCtrlBusyWait(CTRLRB);
+	setRS(DATA);
+	setRW(WRITE);
+	DATABUS = data;
+	for(uint8_t i = 0; i < n; ++i) {
+		halGlcdSetEnableBit();
+		halGlcdClearEnableBit();
+	}
+	
+	// both controllers now point past the written columns, 
+	// the next write goes to the left one
+	halGlcdCtrlSelect(CTRLR2);
+	xDeviceSpace = page;
+	yDeviceSpace = (col + n) % 64;
+	return 0;
+}
+
+uint8_t halGlcdWriteInterleaved(const uint8_t page, 
+					const uint8_t leftCol, const uint8_t *left, uint8_t nLeft,
+					const uint8_t rightCol, const uint8_t *right, uint8_t nRight)
+{
+	uint8_t leftEnd = leftCol + nLeft;
+	uint8_t rightEnd = rightCol + nRight;
+	
+	if(leftCol == rightCol) {
+		halGlcdCtrlSetAddress(CTRLRB, page, leftCol);
+	}
+	else {
+		halGlcdCtrlSetAddress(CTRLR2, page, leftCol);
+		halGlcdCtrlSetAddress(CTRLR1, page, rightCol);
+	}
+	halGlcdCtrlBusyWait(CTRLR1);
+	halGlcdCtrlBusyWait(CTRLR2);
+	setRS(DATA);
+	setRW(WRITE);
+	
+	while(nLeft > 0 && nRight > 0) {
+		halGlcdCtrlSelect(CTRLR2);
+		DATABUS = *left++;
+		halGlcdSetEnableBitShort();
+		halGlcdClearEnableBit();
+		
+		halGlcdCtrlSelect(CTRLR1);
+		DATABUS = *right++;
+		halGlcdSetEnableBitShort();
+		halGlcdClearEnableBit();
+		
+		--nLeft;
+		--nRight;
+	}
+	
+	// whatever is left goes to one controller only
+	if(nLeft > 0) {
+		halGlcdCtrlSelect(CTRLR2);
+	}
+	else {
+		halGlcdCtrlSelect(CTRLR1);
+		left = right;
+		nLeft = nRight;
+	}
+	while(nLeft-- > 0) {
+		DATABUS = *left++;
+		halGlcdSetEnableBit();
+		halGlcdClearEnableBit();
+	}
+	
+	xDeviceSpace = page;
+	yDeviceSpace = ((currCtrlr == CTRLR1) ? rightEnd : leftEnd) % 64;
+	return 0;
+}
+
+uint32_t halGlcdGetBusCycles(void)
+{
+	return busCycles;
+}
+
 uint8_t halGlcdReadData(void)
 {
 	uint8_t res = halGlcdCtrlReadData(currCtrlr);
@@ -129,6 +291,7 @@ uint8_t halGlcdReadData(void)
  *
  ****************/
 
+#ifndef HAL_GLCD_TIMED_BUS
 static void nops3(void)
 {
 	uint32_t i;
@@ -144,6 +307,7 @@ static void nops8(void)
 		asm volatile("nop\n"::);
 	}
 }
+#endif
 
 static void updateY(void)
 {
@@ -157,16 +321,44 @@ static void updateY(void)
 
 static void halGlcdSetResetBit(void)
 {
+#ifdef HAL_GLCD_TIMED_BUS
+	DELAY_NS(T_AS_NS);
+	set_port_bits(PORTE, (1 << PE7));
+	DELAY_NS(T_RST_NS);
+#else
 	nops3();
 	set_port_bits(PORTE, (1 << PE7));
 	nops8();
+#endif
 }
 
 static void halGlcdSetEnableBit(void)
 {
+	++busCycles;
+#ifdef HAL_GLCD_TIMED_BUS
+	DELAY_NS(T_BUSY_NS);
+	set_port_bits(PORTE, (1 << PE6));
+	DELAY_NS(T_WH_NS);
+#else
 	nops8();
 	set_port_bits(PORTE, (1 << PE6));
 	nops8();
+#endif
+}
+
+static void halGlcdSetEnableBitShort(void)
+{
+	++busCycles;
+#ifdef HAL_GLCD_TIMED_BUS
+	// the pulse to the other controller makes up the rest of T_BUSY_NS
+	DELAY_NS(T_BUSY_NS - T_WH_NS);
+	set_port_bits(PORTE, (1 << PE6));
+	DELAY_NS(T_WH_NS);
+#else
+	nops3();
+	set_port_bits(PORTE, (1 << PE6));
+	nops8();
+#endif
 }
 
 static void halGlcdClearEnableBit(void)
@@ -251,6 +443,8 @@ static uint8_t halGlcdCtrlReadData(const uint8_t controller)
 static void halGlcdCtrlBusyWait(const uint8_t controller)
 {
 	halGlcdCtrlSelect(controller);
+	// with the timed bus every enable pulse already waits out the previous access
+#ifndef HAL_GLCD_TIMED_BUS
 	//setAsInNoPullUp(&PORTA, &DDRA, 0xFF);
 	
 	uint8_t isBusy = 0xFF;
@@ -264,4 +458,5 @@ static void halGlcdCtrlBusyWait(const uint8_t controller)
 		halGlcdClearEnableBit();
 	}
 	setAsOut(&PORTA, &DDRA, 0xFF);
+#endif
 }
@@ -15,6 +15,43 @@ uint8_t halGlcdSetAddress(const uint8_t xCol, const uint8_t yPage);
  */
 uint8_t halGlcdWriteData(const uint8_t data);
 
+/**
+ * @brief writes n bytes from buf to the glcd ram, starting at the 
+ * col-th column of the page-th page.
+ *
+ * The controller is selected and waited for once per controller touched, 
+ * instead of once per byte. Writing past the 64th column continues
+ * on the second controller.
+ */
+uint8_t halGlcdWriteBurst(const uint8_t page, const uint8_t col, 
+					const uint8_t *buf, uint8_t n);
+
+/**
+ * @brief writes data n times to both controllers at once, starting at the
+ * col-th column (0 <= col < 64) of the page-th page of each controller.
+ *
+ * Meant for uniform patterns: one write covers a column on each half of the screen.
+ */
+uint8_t halGlcdWriteBroadcast(const uint8_t page, const uint8_t col, 
+					const uint8_t data, uint8_t n);
+
+/**
+ * @brief writes nLeft bytes from left to the left controller starting at its
+ * leftCol-th column, and nRight bytes from right to the right controller starting
+ * at its rightCol-th column, both on the page-th page.
+ *
+ * The writes alternate between the controllers, so each one finishes its
+ * internal write while the other one is being written to.
+ */
+uint8_t halGlcdWriteInterleaved(const uint8_t page, 
+					const uint8_t leftCol, const uint8_t *left, uint8_t nLeft,
+					const uint8_t rightCol, const uint8_t *right, uint8_t nRight);
+
+/**
+ * @brief returns how many bus cycles (enable pulses) were sent to the glcd
+ */
+uint32_t halGlcdGetBusCycles(void);
+
 /**
  * @brief reads data to glcd ram from current address
  */
@@ -0,0 +1,47 @@
+#ifndef __GLCD_SPRITE_DEFINITIONS__
+#define __GLCD_SPRITE_DEFINITIONS__
+
+#include <avr/pgmspace.h>
+
+/**
+ * @brief A 1 bit image with a mask, at most 8 pixels high.
+ *
+ * The columns are stored for all 8 vertical positions within a page,
+ * so that drawing a sprite does not shift anything. Each column is
+ * four bytes: image and mask of the upper page, then image and mask
+ * of the lower page. The columns of a shift follow each other, the 8
+ * shifts of a frame follow each other and the frames follow each other.
+ * Use SPRITE_FRAME4 to generate the data of a frame.
+ */
+typedef struct sprite_t
+{
+    /** Sprite width */
+    uint8_t     width;
+
+    /** Sprite height, limited to 8 pixel (uint8_t) */
+    uint8_t     height;
+
+    /** Columns of all shifts of all frames in progmem */
+    const uint8_t *data;
+} sprite;
+
+// bytes one shift of one column takes up
+#define SPRITE_COL_SIZE 4
+
+// one column with image and mask bits, bit 0 being the top row, shifted down by s rows
+#define SPRITE_COL(img, mask, s) \
+	(uint8_t)((img) << (s)), (uint8_t)((mask) << (s)), \
+	(uint8_t)((img) >> (8 - (s))), (uint8_t)((mask) >> (8 - (s)))
+
+#define SPRITE_SHIFT4(s, i0, m0, i1, m1, i2, m2, i3, m3) \
+	SPRITE_COL(i0, m0, s), SPRITE_COL(i1, m1, s), \
+	SPRITE_COL(i2, m2, s), SPRITE_COL(i3, m3, s)
+
+// all 8 shifts of one frame of a sprite 4 columns wide, given as image, mask pairs
+#define SPRITE_FRAME4(...) \
+	SPRITE_SHIFT4(0, __VA_ARGS__), SPRITE_SHIFT4(1, __VA_ARGS__), \
+	SPRITE_SHIFT4(2, __VA_ARGS__), SPRITE_SHIFT4(3, __VA_ARGS__), \
+	SPRITE_SHIFT4(4, __VA_ARGS__), SPRITE_SHIFT4(5, __VA_ARGS__), \
+	SPRITE_SHIFT4(6, __VA_ARGS__), SPRITE_SHIFT4(7, __VA_ARGS__)
+
+#endif
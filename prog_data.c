@@ -1,5 +1,6 @@
 #include <inttypes.h>
 #include <avr/pgmspace.h>
+#include "glcd/sprite/sprite.h"
 
 const char winMessage[] PROGMEM = "YOU WIN";
 const char loseMessage[] PROGMEM = "YOU LOSE";
@@ -9,14 +10,41 @@ const char connMessage[] PROGMEM = "Waiting on Wiimote";
 const char scoreMessage[] PROGMEM = "SCORE: ";
 const char pressMessage[] PROGMEM = "Press any button";
 
-// image for the start screen encoded so that it can be sent directly to the glcd.
-const uint8_t startScreen[1024] PROGMEM = {
-0, 0, 0, 1, 31, 127, 252, 192, 0, 0, 0, 0, 0, 3, 7, 255, 255, 0, 0, 0, 0, 0, 0, 3, 7, 0, 0, 0, 192, 192, 0, 0, 0, 0, 0, 0, 193, 207, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 31, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 7, 15, 0, 0, 0, 0, 0, 0, 0, 0, 0, 192, 192, 7, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 7, 0, 0, 0, 0, 0, 0, 224, 239, 7, 0, 0, 0, 0, 0, 0, 0, 0, 15, 3, 0, 0, 0, 0, 0, 0, 240, 252, 191, 15, 7, 3, 3, 0, 0, 0, 0, 
-0, 0, 0, 0, 128, 240, 255, 127, 0, 0, 0, 0, 0, 248, 124, 31, 15, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 255, 255, 24, 24, 24, 24, 24, 24, 255, 255, 0, 0, 0, 192, 204, 102, 102, 102, 110, 252, 248, 0, 0, 0, 254, 254, 0, 0, 0, 0, 254, 254, 0, 0, 0, 254, 254, 12, 6, 6, 14, 254, 248, 0, 0, 6, 255, 255, 6, 6, 6, 0, 240, 252, 108, 102, 102, 102, 102, 110, 124, 120, 0, 248, 252, 14, 6, 6, 6, 12, 255, 255, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 7, 255, 248, 0, 0, 0, 0, 0, 0, 0, 
-0, 0, 0, 248, 255, 15, 1, 0, 0, 0, 0, 0, 0, 252, 232, 0, 0, 0, 0, 0, 0, 0, 240, 252, 124, 0, 0, 0, 7, 7, 0, 0, 0, 0, 0, 0, 7, 7, 0, 0, 0, 3, 7, 6, 6, 6, 3, 7, 7, 0, 0, 0, 1, 7, 7, 6, 6, 3, 7, 7, 0, 0, 0, 7, 7, 0, 0, 0, 0, 7, 7, 0, 0, 0, 3, 7, 6, 6, 6, 0, 0, 3, 3, 6, 6, 6, 6, 6, 6, 3, 0, 1, 3, 7, 6, 6, 6, 3, 7, 7, 0, 0, 0, 0, 96, 252, 192, 0, 0, 0, 0, 0, 0, 0, 0, 0, 192, 252, 255, 31, 3, 0, 0, 0, 0, 0, 0, 0, 
-0, 0, 0, 63, 255, 240, 0, 0, 0, 0, 0, 0, 16, 255, 243, 128, 0, 0, 0, 0, 0, 3, 31, 1, 0, 0, 0, 0, 0, 0, 0, 0, 255, 252, 240, 0, 0, 0, 0, 0, 0, 0, 0, 252, 252, 28, 248, 224, 0, 0, 192, 248, 28, 252, 252, 0, 0, 0, 0, 192, 96, 96, 96, 224, 192, 128, 0, 0, 96, 96, 96, 96, 96, 224, 224, 96, 0, 0, 192, 192, 96, 96, 96, 96, 224, 192, 128, 0, 0, 0, 0, 0, 0, 0, 0, 128, 0, 0, 0, 0, 0, 0, 0, 0, 225, 255, 255, 0, 0, 0, 0, 0, 0, 0, 0, 0, 255, 255, 128, 0, 0, 0, 0, 0, 0, 0, 0, 0, 
-0, 0, 0, 0, 3, 255, 255, 0, 0, 0, 0, 0, 0, 3, 31, 255, 252, 0, 0, 0, 0, 224, 254, 63, 0, 0, 0, 0, 0, 0, 0, 128, 199, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 127, 127, 0, 0, 3, 15, 15, 3, 0, 0, 127, 127, 0, 0, 0, 60, 124, 102, 102, 102, 54, 127, 127, 0, 0, 96, 112, 124, 126, 103, 99, 96, 96, 0, 15, 63, 54, 102, 102, 102, 102, 102, 103, 55, 0, 0, 0, 0, 0, 0, 0, 0, 255, 240, 0, 0, 0, 0, 0, 0, 126, 255, 227, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 255, 255, 0, 0, 0, 0, 0, 0, 0, 0, 0, 
-0, 0, 0, 248, 254, 63, 7, 0, 0, 0, 0, 0, 0, 240, 252, 127, 15, 0, 0, 0, 0, 127, 255, 240, 128, 0, 0, 0, 0, 0, 0, 255, 255, 128, 0, 0, 0, 0, 0, 0, 0, 0, 0, 224, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 192, 128, 0, 0, 192, 0, 0, 64, 0, 0, 224, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 224, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 63, 255, 255, 0, 0, 0, 0, 0, 0, 254, 255, 31, 0, 0, 0, 0, 0, 0, 0, 0, 0, 208, 255, 31, 7, 0, 0, 0, 0, 0, 0, 0, 0, 0, 
-0, 0, 0, 255, 255, 0, 0, 0, 0, 0, 0, 24, 255, 255, 193, 0, 0, 0, 0, 0, 0, 0, 1, 255, 255, 0, 0, 0, 0, 0, 0, 193, 255, 255, 0, 0, 0, 0, 0, 0, 0, 0, 0, 31, 17, 17, 14, 0, 67, 76, 56, 140, 131, 128, 128, 0, 0, 31, 1, 2, 12, 31, 0, 0, 31, 0, 0, 223, 4, 10, 145, 0, 14, 209, 17, 14, 0, 0, 31, 0, 0, 24, 21, 21, 30, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 255, 243, 0, 0, 0, 0, 0, 0, 7, 31, 126, 248, 224, 128, 0, 0, 0, 0, 0, 0, 0, 63, 255, 248, 192, 0, 0, 0, 0, 0, 0, 0, 0, 
-0, 0, 208, 255, 63, 0, 0, 0, 0, 0, 0, 0, 1, 191, 255, 0, 0, 0, 0, 0, 0, 0, 0, 127, 127, 0, 0, 0, 0, 0, 255, 63, 7, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 63, 32, 32, 49, 31, 0, 0, 28, 34, 34, 28, 0, 0, 28, 34, 34, 63, 0, 0, 62, 0, 0, 63, 8, 20, 34, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 31, 255, 248, 0, 0, 0, 0, 0, 0, 0, 1, 255, 255, 0, 0, 0, 0, 0, 0, 0, 0, 0, 7, 255, 172, 0, 0, 0, 0, 0, 0, 0
+// ghost, every pixel of its box is drawn so that the eyes and legs are cut out
+static const uint8_t ghostData[] PROGMEM = {
+	SPRITE_FRAME4(0x3E, 0x3F, 0x3B, 0x3F, 0x3F, 0x3F, 0x3A, 0x3F)
+};
+const sprite ghostSprite = {4, 6, ghostData};
+
+// pacman with the mouth open and closed, only the pixels set are drawn
+static const uint8_t pacmanData[] PROGMEM = {
+	SPRITE_FRAME4(0x06, 0x06, 0x0F, 0x0F, 0x0B, 0x0B, 0x0A, 0x0A),
+	SPRITE_FRAME4(0x06, 0x06, 0x0F, 0x0F, 0x0F, 0x0F, 0x0E, 0x0E)
+};
+const sprite pacmanSprite = {4, 4, pacmanData};
+
+// image for the start screen, packed with tools/rle_encode from the 1024 bytes sent to the glcd
+const uint8_t startScreen[681] PROGMEM = {
+128, 0, 4, 1, 31, 127, 252, 192, 130, 0, 3, 3, 7, 255, 255, 131, 0, 1, 3, 7, 128, 0, 1, 192, 192, 131, 0, 1, 193, 207, 138, 0, 
+1, 3, 31, 135, 0, 1, 7, 15, 134, 0, 3, 192, 192, 7, 1, 137, 0, 1, 1, 7, 131, 0, 2, 224, 239, 7, 133, 0, 1, 15, 3, 131, 
+0, 6, 240, 252, 191, 15, 7, 3, 3, 129, 0, 129, 0, 3, 128, 240, 255, 127, 130, 0, 3, 248, 124, 31, 15, 136, 0, 1, 255, 255, 131, 24, 
+1, 255, 255, 128, 0, 1, 192, 204, 128, 102, 2, 110, 252, 248, 128, 0, 1, 254, 254, 129, 0, 1, 254, 254, 128, 0, 12, 254, 254, 12, 6, 6, 
+14, 254, 248, 0, 0, 6, 255, 255, 128, 6, 3, 0, 240, 252, 108, 129, 102, 6, 110, 124, 120, 0, 248, 252, 14, 128, 6, 2, 12, 255, 255, 142, 
+0, 3, 1, 7, 255, 248, 132, 0, 128, 0, 3, 248, 255, 15, 1, 131, 0, 1, 252, 232, 132, 0, 2, 240, 252, 124, 128, 0, 1, 7, 7, 131, 
+0, 1, 7, 7, 128, 0, 1, 3, 7, 128, 6, 2, 3, 7, 7, 128, 0, 7, 1, 7, 7, 6, 6, 3, 7, 7, 128, 0, 1, 7, 7, 129, 
+0, 1, 7, 7, 128, 0, 1, 3, 7, 128, 6, 3, 0, 0, 3, 3, 131, 6, 4, 3, 0, 1, 3, 7, 128, 6, 2, 3, 7, 7, 129, 0, 
+2, 96, 252, 192, 134, 0, 4, 192, 252, 255, 31, 3, 132, 0, 128, 0, 2, 63, 255, 240, 131, 0, 3, 16, 255, 243, 128, 130, 0, 2, 3, 31, 
+1, 133, 0, 2, 255, 252, 240, 133, 0, 11, 252, 252, 28, 248, 224, 0, 0, 192, 248, 28, 252, 252, 129, 0, 0, 192, 128, 96, 4, 224, 192, 128, 
+0, 0, 130, 96, 6, 224, 224, 96, 0, 0, 192, 192, 129, 96, 2, 224, 192, 128, 133, 0, 0, 128, 133, 0, 2, 225, 255, 255, 134, 0, 2, 255, 
+255, 128, 134, 0, 129, 0, 2, 3, 255, 255, 131, 0, 3, 3, 31, 255, 252, 129, 0, 2, 224, 254, 63, 132, 0, 2, 128, 199, 3, 134, 0, 11, 
+127, 127, 0, 0, 3, 15, 15, 3, 0, 0, 127, 127, 128, 0, 1, 60, 124, 128, 102, 16, 54, 127, 127, 0, 0, 96, 112, 124, 126, 103, 99, 96, 
+96, 0, 15, 63, 54, 130, 102, 1, 103, 55, 133, 0, 1, 255, 240, 131, 0, 2, 126, 255, 227, 136, 0, 1, 255, 255, 134, 0, 128, 0, 3, 248, 
+254, 63, 7, 131, 0, 3, 240, 252, 127, 15, 129, 0, 3, 127, 255, 240, 128, 131, 0, 2, 255, 255, 128, 134, 0, 0, 224, 138, 0, 10, 192, 128, 
+0, 0, 192, 0, 0, 64, 0, 0, 224, 135, 0, 0, 224, 140, 0, 2, 63, 255, 255, 131, 0, 2, 254, 255, 31, 134, 0, 3, 208, 255, 31, 7, 
+134, 0, 128, 0, 1, 255, 255, 131, 0, 3, 24, 255, 255, 193, 132, 0, 2, 1, 255, 255, 131, 0, 2, 193, 255, 255, 134, 0, 41, 31, 17, 17, 
+14, 0, 67, 76, 56, 140, 131, 128, 128, 0, 0, 31, 1, 2, 12, 31, 0, 0, 31, 0, 0, 223, 4, 10, 145, 0, 14, 209, 17, 14, 0, 0, 
+31, 0, 0, 24, 21, 21, 30, 134, 0, 2, 16, 255, 243, 131, 0, 5, 7, 31, 126, 248, 224, 128, 132, 0, 3, 63, 255, 248, 192, 133, 0, 4, 
+0, 0, 208, 255, 63, 132, 0, 2, 1, 191, 255, 133, 0, 1, 127, 127, 130, 0, 3, 255, 63, 7, 1, 142, 0, 25, 63, 32, 32, 49, 31, 0, 
+0, 28, 34, 34, 28, 0, 0, 28, 34, 34, 63, 0, 0, 62, 0, 0, 63, 8, 20, 34, 143, 0, 3, 3, 31, 255, 248, 132, 0, 2, 1, 255, 
+255, 134, 0, 2, 7, 255, 172, 132, 0
 };
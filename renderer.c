@@ -3,17 +3,43 @@
 #include <avr/pgmspace.h>
 #include "glcd/font/Standard5x7.h"
 #include <stdlib.h>
+#include <string.h>
 
-#define START_SCREEN_LEN 1024
 #define NEGATIVE_TICKS 16
 #define PAC_TICKS 4
 
+// how many bytes one background slice sends to the screen
+#define FLUSH_SLICE 16
+
+/**
+ * @brief When this define exists, the last frame is scrolled along with
+ * the camera instead of being cleared. Vertical movement moves the start 
+ * line of the display, horizontal movement shifts the framebuffer. Only 
+ * the rows and columns scrolling in, the boxes the sprites were drawn in
+ * and the eaten points are drawn again.
+ *
+ * If the define is deleted, every frame is drawn from scratch.
+ */
+#define USE_HW_SCROLL
+
+/**
+ * @brief Without the glcd framebuffer, maze frames are not drawn but 
+ * composed page by page from the game state while endRender() sends them.
+ *
+ * renderMaze(), renderPlayer() and renderGhosts() then only record what 
+ * to compose. Every maze frame is sent in full.
+ */
+#ifndef USE_FRAME_BUFFER
+#define USE_STREAM_RENDER
+#undef USE_HW_SCROLL
+#endif
+
 // top left corner of the camera in world space 
 static int16_t camX = 0;
 static int16_t camY = 0;
 
-// an array containing the information on how pacman looks. Not in PROGMEM because they are edited.
-static uint8_t pacman[4][4] = { {0, 1, 1, 0}, {1, 1, 1, 1}, {1, 1, 0, 0}, {0, 1, 1, 1} };
+// frame of pacmanSprite to be drawn, toggles between mouth open and closed
+static uint8_t pacmanFrame = 0;
 
 // pointers to the player position
 static int16_t* _playerX;
@@ -25,20 +51,125 @@ static uint8_t playerSize;
 // how many times the update animation routine has been called
 static uint16_t ticksPassed = 0;
 
+// how many frames were not drawn to keep up with the game ticks
+static uint16_t skippedFrames = 0;
+
+#ifdef USE_HW_SCROLL
+// set if the framebuffer holds the maze as seen from camX, camY of the last frame
+static uint8_t mazeValid = 0;
+
+// camera of the frame in the framebuffer
+static int16_t lastCamX;
+static int16_t lastCamY;
+
+// set if only parts of the frame are drawn again
+static uint8_t incremental = 0;
+
+// screen rows and columns which scrolled in, drawn again in full
+static int16_t exposedTop;
+static int16_t exposedBottom;
+static int16_t exposedLeft;
+static int16_t exposedRight;
+
+// box of a sprite in world space, where the maze is drawn again next frame
+typedef struct dirty_rect_t {
+	int16_t x, y;
+	uint8_t w, h;
+} dirty_rect;
+
+// the sprites drawn in the last frame, the player box of this one and the minimap
+#define MAX_DIRTY_RECTS (GHOST_COUNT + 3)
+static dirty_rect dirtyRects[MAX_DIRTY_RECTS];
+static uint8_t dirtyRectCount = 0;
+
+// records the box of a sprite in world space. If there is no room 
+// left, the next frame is drawn from scratch.
+static void markRect(int16_t x, int16_t y, uint8_t w, uint8_t h);
+
+// points under the player in all ticks since the last drawn frame, 
+// in world space, drawn again next frame
+static uint8_t eatenPending = 0;
+static int16_t eatenX0;
+static int16_t eatenY0;
+static int16_t eatenX1;
+static int16_t eatenY1;
+
+// adds the points in the tiles under the player to the eaten area
+static void markEatenPoints(void);
+#endif
+
+#ifdef USE_STREAM_RENDER
+// set by startMazeRender(), the frame is composed by endRender()
+static uint8_t streamMaze = 0;
+
+// what to compose, recorded by the render functions
+static maze_tile (*streamTiles)[MAZE_HEIGHT];
+static uint8_t (*streamPoints)[MAZE_HEIGHT];
+static uint8_t streamPlayer;
+static ghost *streamGhosts;
+static uint8_t streamGhostCount;
+static uint8_t streamMinimap;
+
+// composes one screen page of the maze frame, for glcdComposeScreen
+static void composeMazePage(const uint8_t page, uint8_t *line);
+#endif
+
+/**
+ * @brief Draws the maze inside a rectangle of the screen, clipped to it.
+ *
+ * @param x0 Left column of the rectangle, may lie outside the screen.
+ * @param y0 Top row of the rectangle, may lie outside the screen.
+ * @param x1 Right column of the rectangle, may lie outside the screen.
+ * @param y1 Bottom row of the rectangle, may lie outside the screen.
+ */
+static void drawMazeArea(maze_tile maze[][MAZE_HEIGHT], uint8_t points[][MAZE_HEIGHT],
+					int16_t x0, int16_t y0, int16_t x1, int16_t y1);
+
 /**
- * @brief Draws one tile of the maze and a point in it, if point is set
+ * @brief Draws one tile of the maze and a point in it, if point is set.
+ *
+ * The tile is blitted from tileBitmaps in world space, the glcd viewport 
+ * and clip rectangle take care of the camera and the screen edges. It 
+ * replaces everything in its box.
  * @param tile Maze tile to be drawn
  * @param point Draw the point in tile if point is 1. 
- * @param p1X Top left x tile coordinate in world space.
- * @param p1Y Top left y tile coordinate in world space.
- * @param p2X Bottom right x tile coordinate in world space.
- * @param p2Y Bottom right y tile coordinate in world space.
+ * @param tx X index of the tile in the maze.
+ * @param ty Y index of the tile in the maze.
  */
-static void drawTile(maze_tile tile, uint8_t point, int16_t p1X, int16_t p1Y,
-					int16_t p2X, int16_t p2Y, void (*drawPx)(const uint8_t, const uint8_t));
+static void drawTile(maze_tile tile, uint8_t point, uint8_t tx, uint8_t ty);
+
+// index of the tileBitmaps entry for a tile
+static uint8_t tileVariant(maze_tile tile, uint8_t point);
+
+// returns 1 if the box in world space is at least partially in view of the camera
+static inline uint8_t onCamera(int16_t x, int16_t y, uint8_t w, uint8_t h);
+
+// position and size of the point in its tile
+#define POINT_OFFSET 3
+#define POINT_SIZE 2
+
+// column c of the tile bitmap for variant v, bit 0 being the top row. The bits 
+// of v are freeLeft, freeRight, freeTop, freeBottom, isEnd and the point.
+#define TILE_COL(v, c) (uint8_t)( \
+	(((v) & 0x01) ? 0 : (((c) == 0) ? 0xFF : 0)) | \
+	(((v) & 0x02) ? 0 : (((c) == 7) ? 0xFF : 0)) | \
+	(((v) & 0x04) ? 0 : 0x01) | \
+	(((v) & 0x08) ? 0 : 0x80) | \
+	(((v) & 0x10) ? ((1 << (c)) | (0x80 >> (c))) : 0) | \
+	((((v) & 0x20) && (c) >= POINT_OFFSET && (c) < POINT_OFFSET + POINT_SIZE) ? \
+		(((1 << POINT_SIZE) - 1) << POINT_OFFSET) : 0))
+#define TILE_BITMAP(v) {TILE_COL(v, 0), TILE_COL(v, 1), TILE_COL(v, 2), TILE_COL(v, 3), \
+	TILE_COL(v, 4), TILE_COL(v, 5), TILE_COL(v, 6), TILE_COL(v, 7)}
+#define TILE_BITMAPS4(v) TILE_BITMAP(v), TILE_BITMAP((v) + 1), TILE_BITMAP((v) + 2), TILE_BITMAP((v) + 3)
+#define TILE_BITMAPS16(v) TILE_BITMAPS4(v), TILE_BITMAPS4((v) + 4), TILE_BITMAPS4((v) + 8), TILE_BITMAPS4((v) + 12)
+
+// every tile drawTile can draw, see TILE_COL
+static const uint8_t tileBitmaps[64][TILE_SIZE] PROGMEM = {
+	TILE_BITMAPS16(0), TILE_BITMAPS16(16), TILE_BITMAPS16(32), TILE_BITMAPS16(48)
+};
 					
 // image for the start screen			
-extern const uint8_t startScreen[START_SCREEN_LEN] PROGMEM;
+extern const uint8_t startScreen[] PROGMEM;
 extern const char winMessage[] PROGMEM;
 extern const char OK[] PROGMEM;
 extern const char newGameMessage[] PROGMEM;
@@ -46,44 +177,82 @@ extern const char connMessage[] PROGMEM;
 extern const char loseMessage[] PROGMEM;
 extern const char scoreMessage[] PROGMEM;
 extern const char pressMessage[] PROGMEM;
+extern const sprite ghostSprite;
+extern const sprite pacmanSprite;
 
 // should the negative of a button be drawn
 static uint8_t okNegative = 0;
 
+// menu screens the framebuffer can hold. They are composed once, after
+// that only their button is inverted when it blinks.
+typedef enum {
+	MENU_NONE,
+	MENU_END_WON,
+	MENU_END_LOST,
+	MENU_CONNECTING
+} menu_screen;
+
+// menu in the framebuffer, MENU_NONE once anything else is drawn
+static menu_screen cachedMenu = MENU_NONE;
+
+// score shown on the cached end screen
+static uint16_t cachedScore;
+
+// okNegative as shown on the cached menu
+static uint8_t cachedNegative;
+
+// the button of the cached menu, its negative is the button inverted
+static xy_point buttonFrom;
+static xy_point buttonTo;
+
+// inverts the button of the cached menu if okNegative changed since
+static void blinkMenu(void);
+
+// the minimap shows every tile as 2x2 pixels in the top right corner
+#define MINIMAP_SCALE 2
+#define MINIMAP_WIDTH (MAZE_WIDTH * MINIMAP_SCALE)
+#define MINIMAP_HEIGHT (MAZE_HEIGHT * MINIMAP_SCALE)
+#define MINIMAP_X (SCREEN_WIDTH - MINIMAP_WIDTH)
+#define MINIMAP_Y 0
+
+// the minimap, page by page like the framebuffer
+static uint8_t minimap[MINIMAP_HEIGHT / 8][MINIMAP_WIDTH];
+
+// the maze the minimap shows, NULL until buildMinimap() is called
+static maze_tile (*minimapTiles)[MAZE_HEIGHT] = NULL;
+static uint8_t (*minimapPoints)[MAZE_HEIGHT];
+
+// tile the player is marked in
+static uint8_t minimapPlayerX;
+static uint8_t minimapPlayerY;
+
+// draws the cell of one tile into the minimap
+static void minimapCell(uint8_t tx, uint8_t ty);
+
 void renderGhosts(ghost ghosts[], uint8_t ghostCount)
 {
-	uint16_t gX, gY;
+#ifdef USE_STREAM_RENDER
+	streamGhosts = ghosts;
+	streamGhostCount = ghostCount;
+	return;
+#endif
 	for(uint8_t k = 0; k < ghostCount; ++k) {
-		ghost currGhost = ghosts[k];
-		for(uint8_t i = 0; i < GHOST_W; ++i) {
-			for(uint8_t j = 0; j < GHOST_H; ++j) {
-				gX = currGhost.x + i - camX;
-				gY = currGhost.y + j - camY;
-				if(gX >= 0 && gY >= 0 && 
-					gX < SCREEN_WIDTH && gY < SCREEN_HEIGHT)
-				{
-					if(!(i == 1 && j == 2) && 
-						!(i == 3 && j == 2) &&
-						!(i == 0 && j == 0) &&
-						!(i == GHOST_W - 1 && j == 0)){ // hardcoded eyes and legs
-						glcdSetPixel(gX, gY);
-					}
-					else {
-						glcdClearPixel(gX, gY);
-					}
-				}
-			}
-		} 
+		// most ghosts are somewhere else in the maze
+		if(!onCamera(ghosts[k].x, ghosts[k].y, GHOST_W, GHOST_H)) {
+			continue;
+		}
+		glcdBlitSprite(&ghostSprite, 0, ghosts[k].x, ghosts[k].y);
+#ifdef USE_HW_SCROLL
+		markRect(ghosts[k].x, ghosts[k].y, GHOST_W, GHOST_H);
+#endif
 	}
 }
 
 uint8_t updateStartScreen(void)
 {
 	static uint8_t currRow = 0;
-	for(uint8_t i = 0; i < SCREEN_WIDTH; ++i) {
-		glcdInvertPixel(i, currRow);
-	}
-	glcdFlushFramebuffer();
+	glcdDrawHorizontalOp(currRow, ROP_INVERT);
+	glcdFlushRegion(0, currRow, SCREEN_WIDTH - 1, currRow);
 	++currRow;
 	if(currRow == SCREEN_HEIGHT) {
 		return 1;
@@ -93,12 +262,21 @@ uint8_t updateStartScreen(void)
 
 void drawStartScreen(void)
 {
-	glcdDrawArrayPgm((PGM_P)startScreen, START_SCREEN_LEN * 8);
+	cachedMenu = MENU_NONE;
+	glcdSetViewport(0, 0);
+	glcdDrawRleImagePgm((PGM_P)startScreen);
 	glcdFlushFramebuffer();
 }
 
 void drawEndScreen(uint8_t won, uint16_t score)
 {
+	menu_screen menu = (won == 1) ? MENU_END_WON : MENU_END_LOST;
+	if(cachedMenu == menu && cachedScore == score) {
+		blinkMenu();
+		return;
+	}
+	startRender();
+	
 	char buffer[8];
 	itoa(score, buffer, 10);
 	xy_point scoreLoc = {32, SCREEN_HEIGHT - Standard5x7.lineSpacing};
@@ -111,7 +289,7 @@ void drawEndScreen(uint8_t won, uint16_t score)
 	if(won == 1) {
 		mssg = (PGM_P)winMessage;
 	}
-	else if(won == 0) {
+	else {
 		mssg = (PGM_P)loseMessage;
 	}
 	
@@ -125,44 +303,57 @@ void drawEndScreen(uint8_t won, uint16_t score)
 	textLoc.y += Standard5x7.lineSpacing * 2;
 	textLoc.x = SCREEN_WIDTH / 2 - Standard5x7.charSpacing * (strlen_P(OK) / 2);
 	
-	xy_point esRectStart; 
-	xy_point esRectEnd;
-	esRectStart = textLoc;
-	esRectStart.x -= 10;
-	esRectStart.y -= 3;
-	esRectEnd.y = esRectStart.y + Standard5x7.lineSpacing;
-	esRectEnd.x = SCREEN_WIDTH / 2 + Standard5x7.charSpacing * (strlen_P(OK) / 2);
-	esRectEnd.x += 8;
-	esRectEnd.y += 4;
+	buttonFrom = textLoc;
+	buttonFrom.x -= 10;
+	buttonFrom.y -= 3;
+	buttonTo.y = buttonFrom.y + Standard5x7.lineSpacing;
+	buttonTo.x = SCREEN_WIDTH / 2 + Standard5x7.charSpacing * (strlen_P(OK) / 2);
+	buttonTo.x += 8;
+	buttonTo.y += 4;
+	glcdDrawTextPgm((PGM_P)OK, textLoc, &Standard5x7, glcdSetPixel);
 	
-	if(!okNegative) {
-		glcdDrawTextPgm((PGM_P)OK, textLoc, &Standard5x7, glcdSetPixel);
-	} else {
-		glcdFillRect(esRectStart, esRectEnd, glcdSetPixel);
-		glcdDrawTextPgm((PGM_P)OK, textLoc, &Standard5x7, glcdClearPixel);
-	}
+	cachedMenu = menu;
+	cachedScore = score;
+	cachedNegative = 0;
+	blinkMenu();
 }
 
 void drawConnectingScreen(void)
 {
-	xy_point textLoc, rectStart, rectEnd;
+	if(cachedMenu == MENU_CONNECTING) {
+		blinkMenu();
+		return;
+	}
+	startRender();
+	
+	xy_point textLoc;
 	textLoc.x = SCREEN_WIDTH / 2 - Standard5x7.charSpacing * (strlen_P(connMessage) / 2) + 1;
 	textLoc.y = 20;
-	rectStart = rectEnd = textLoc;
-	rectStart.x -= 5;
-	rectStart.y -= 4;
-	rectEnd.x += Standard5x7.charSpacing * strlen_P(connMessage) + 3;
-	rectEnd.y += 11;
-	
-	if(!okNegative) {
-		glcdDrawTextPgm((PGM_P)connMessage, textLoc, &Standard5x7, glcdSetPixel);
-	} else {
-		glcdFillRect(rectStart, rectEnd, glcdSetPixel);
-		glcdDrawTextPgm((PGM_P)connMessage, textLoc, &Standard5x7, glcdClearPixel);
-	}
+	buttonFrom = buttonTo = textLoc;
+	buttonFrom.x -= 5;
+	buttonFrom.y -= 4;
+	buttonTo.x += Standard5x7.charSpacing * strlen_P(connMessage) + 3;
+	buttonTo.y += 11;
+	glcdDrawTextPgm((PGM_P)connMessage, textLoc, &Standard5x7, glcdSetPixel);
 	
 	xy_point pressLoc = {SCREEN_WIDTH / 2- Standard5x7.charSpacing * (strlen_P(pressMessage) / 2), SCREEN_HEIGHT - Standard5x7.lineSpacing * 2};
 	glcdDrawTextPgm((PGM_P)pressMessage, pressLoc, &Standard5x7, glcdSetPixel);
+	
+	cachedMenu = MENU_CONNECTING;
+	cachedNegative = 0;
+	blinkMenu();
+}
+
+static void blinkMenu(void)
+{
+	if(cachedNegative == okNegative) {
+		return;
+	}
+	// the last frame has to be on screen before the framebuffer is changed
+	while(!glcdFlushStep(FLUSH_SLICE)) {
+	}
+	glcdFillRectOp(buttonFrom, buttonTo, ROP_INVERT);
+	cachedNegative = okNegative;
 }
 
 void updateAnimations(void)
@@ -172,8 +363,7 @@ void updateAnimations(void)
 		okNegative = !okNegative;
 	}
 	if(ticksPassed % PAC_TICKS == 0) {
-		pacman[2][3] = !pacman[2][3];
-		pacman[2][2] = !pacman[2][2];
+		pacmanFrame = !pacmanFrame;
 	}
 }
 
@@ -205,12 +395,85 @@ void updateCamera(void)
 
 void endRender(void)
 {	
-	glcdFlushFramebuffer();
+#ifdef USE_STREAM_RENDER
+	if(streamMaze) {
+		streamMaze = 0;
+		glcdComposeScreen(composeMazePage);
+		return;
+	}
+#endif
+	glcdFlushBegin();
+}
+
+void renderBckg(void)
+{
+	glcdFlushStep(FLUSH_SLICE);
+}
+
+void skipRender(void)
+{
+	++skippedFrames;
+#ifdef USE_HW_SCROLL
+	// points eaten in this tick are removed by the next drawn frame
+	markEatenPoints();
+#endif
+}
+
+uint16_t getSkippedFrameCount(void)
+{
+	return skippedFrames;
 }
 
 void startRender(void)
 {
+	// the last frame has to be on screen before the framebuffer is reused
+	while(!glcdFlushStep(FLUSH_SLICE)) {
+	}
 	glcdFillScreen(0x00);
+	glcdSetViewport(0, 0);
+	cachedMenu = MENU_NONE;
+#ifdef USE_HW_SCROLL
+	mazeValid = 0;
+#endif
+}
+
+void startMazeRender(void)
+{
+	cachedMenu = MENU_NONE;
+#ifdef USE_HW_SCROLL
+	while(!glcdFlushStep(FLUSH_SLICE)) {
+	}
+	int16_t dx = camX - lastCamX;
+	int16_t dy = camY - lastCamY;
+	incremental = (mazeValid && dx > -SCREEN_WIDTH && dx < SCREEN_WIDTH && 
+					dy > -SCREEN_HEIGHT && dy < SCREEN_HEIGHT);
+	if(incremental) {
+		glcdScroll(dy);
+		glcdScrollHorizontal(dx);
+		// empty ranges if the camera did not move that way
+		exposedTop = (dy > 0) ? SCREEN_HEIGHT - dy : 0;
+		exposedBottom = (dy > 0) ? SCREEN_HEIGHT - 1 : -dy - 1;
+		exposedLeft = (dx > 0) ? SCREEN_WIDTH - dx : 0;
+		exposedRight = (dx > 0) ? SCREEN_WIDTH - 1 : -dx - 1;
+	}
+	else {
+		glcdFillScreen(0x00);
+		dirtyRectCount = 0;
+	}
+	lastCamX = camX;
+	lastCamY = camY;
+	mazeValid = 1;
+#elif defined(USE_STREAM_RENDER)
+	// every pixel is composed, nothing to clear
+	streamMaze = 1;
+	streamTiles = NULL;
+	streamPlayer = 0;
+	streamGhostCount = 0;
+	streamMinimap = 0;
+#else
+	startRender();
+#endif
+	glcdSetViewport(camX, camY);
 }
 
 void rendererInit(int16_t* playerX, int16_t* playerY, uint8_t psize)
@@ -223,95 +486,255 @@ void rendererInit(int16_t* playerX, int16_t* playerY, uint8_t psize)
 
 void renderPlayer(void)
 {
-	int16_t playerX = *_playerX;
-	int16_t playerY = *_playerY;
-	
-	for(uint8_t i = 0; i < playerSize; ++i) {
-		for(uint8_t j = 0; j < playerSize; ++j) {
-			if(pacman[j][i]) {
-				glcdSetPixel(playerX + i - camX, playerY + j - camY);
-			}
-		}
-	} 
+#ifdef USE_STREAM_RENDER
+	streamPlayer = 1;
+	return;
+#endif
+	glcdBlitSprite(&pacmanSprite, pacmanFrame, *_playerX, *_playerY);
+#ifdef USE_HW_SCROLL
+	markRect(*_playerX, *_playerY, playerSize, playerSize);
+#endif
 }
 
 void renderMaze(maze_tile maze[][MAZE_HEIGHT], uint8_t points[][MAZE_HEIGHT])
 {
-	uint16_t tileStartX = (camX / TILE_SIZE);
-	uint16_t xOffset = camX % TILE_SIZE;
-	uint16_t tileStartY = (camY / TILE_SIZE);
-	uint16_t yOffset = camY % TILE_SIZE;
-	int16_t p1X, p1Y, p2X, p2Y;
-	for(uint8_t i = 0; i < SCREEN_WIDTH + xOffset; i += TILE_SIZE) {
-		for(uint8_t j = 0; j < SCREEN_HEIGHT + yOffset; j += TILE_SIZE) {
-			p1X = i - xOffset;
-			p1Y = j - yOffset;
-			p2X = i + TILE_SIZE - 1 - xOffset;
-			p2Y = j + TILE_SIZE - 1 - yOffset;
-			drawTile(maze[i / TILE_SIZE + tileStartX][j / TILE_SIZE + tileStartY], points[i / TILE_SIZE + tileStartX][j / TILE_SIZE + tileStartY], p1X, p1Y, p2X, p2Y, glcdSetPixel);
+#ifdef USE_STREAM_RENDER
+	streamTiles = maze;
+	streamPoints = points;
+	return;
+#endif
+#ifdef USE_HW_SCROLL
+	if(incremental) {
+		// the points eaten since the last frame are in the tiles under the player
+		markEatenPoints();
+		markRect(eatenX0, eatenY0, eatenX1 - eatenX0, eatenY1 - eatenY0);
+		eatenPending = 0;
+		drawMazeArea(maze, points, 0, exposedTop, SCREEN_WIDTH - 1, exposedBottom);
+		drawMazeArea(maze, points, exposedLeft, 0, exposedRight, SCREEN_HEIGHT - 1);
+		for(uint8_t i = 0; i < dirtyRectCount; ++i) {
+			int16_t x = dirtyRects[i].x - camX;
+			int16_t y = dirtyRects[i].y - camY;
+			drawMazeArea(maze, points, x, y, x + dirtyRects[i].w - 1, y + dirtyRects[i].h - 1);
 		}
+		dirtyRectCount = 0;
+		return;
 	}
+	eatenPending = 0;
+#endif
+	drawMazeArea(maze, points, 0, 0, SCREEN_WIDTH - 1, SCREEN_HEIGHT - 1);
 }
 
-
-// points in screen space... probably... what the hell did I do here?!
-static void drawTile(maze_tile tile, uint8_t point, int16_t p1X, int16_t p1Y,
-					int16_t p2X, int16_t p2Y, void (*drawPx)(const uint8_t, const uint8_t))
+static void drawMazeArea(maze_tile maze[][MAZE_HEIGHT], uint8_t points[][MAZE_HEIGHT],
+					int16_t x0, int16_t y0, int16_t x1, int16_t y1)
 {
-	// clamp values
-	xy_point topLeft = { 
-						((p1X >= 0)?p1X:0), 
-						((p1Y >= 0)?p1Y:0) 
-						 }; //p1
-	xy_point topRight = { 
-						((p2X < SCREEN_WIDTH)?p2X:SCREEN_WIDTH - 1), 
-						((p1Y >= 0)?p1Y:0) 
-						}; //p2X, p1Y};
-	xy_point bottomLeft = { 
-						((p1X >= 0)?p1X:0), 
-						((p2Y < SCREEN_HEIGHT)?p2Y:SCREEN_HEIGHT - 1) 
-						}; //p1X, p2Y}; 
-	xy_point bottomRight = {
-						((p2X < SCREEN_WIDTH)?p2X:SCREEN_WIDTH - 1), 
-						((p2Y < SCREEN_HEIGHT)?p2Y:SCREEN_HEIGHT - 1) 
-						}; // p2;
+	if(x0 < 0) {
+		x0 = 0;
+	}
+	if(y0 < 0) {
+		y0 = 0;
+	}
+	if(x1 > SCREEN_WIDTH - 1) {
+		x1 = SCREEN_WIDTH - 1;
+	}
+	if(y1 > SCREEN_HEIGHT - 1) {
+		y1 = SCREEN_HEIGHT - 1;
+	}
+	if(x1 < x0 || y1 < y0) {
+		return;
+	}
 	
-	if(point != 0) {
-		int16_t pointTLX = p1X + 3;
-		int16_t pointTLY = p1Y + 3;
-		
-		for(int16_t i = 0; i < 2; ++i) {
-			for(int16_t j = 0; j < 2; ++j) {
-				if(pointTLX + i >= 0 && pointTLX + i < SCREEN_WIDTH &&
-					pointTLY + j >= 0 && pointTLY + j < SCREEN_HEIGHT) {
-					glcdSetPixel(pointTLX + i, pointTLY + j);
+	// the tiles only replace the pixels inside the area
+	glcdSetClip(x0, y0, x1, y1);
+	uint8_t tileStartX = (camX + x0) / TILE_SIZE;
+	uint8_t tileEndX = (camX + x1) / TILE_SIZE;
+	uint8_t tileStartY = (camY + y0) / TILE_SIZE;
+	uint8_t tileEndY = (camY + y1) / TILE_SIZE;
+	for(uint8_t tx = tileStartX; tx <= tileEndX; ++tx) {
+		for(uint8_t ty = tileStartY; ty <= tileEndY; ++ty) {
+			drawTile(maze[tx][ty], points[tx][ty], tx, ty);
+		}
+	}
+	glcdResetClip();
+}
+
+#ifdef USE_HW_SCROLL
+static void markRect(int16_t x, int16_t y, uint8_t w, uint8_t h)
+{
+	if(dirtyRectCount == MAX_DIRTY_RECTS) {
+		mazeValid = 0;
+		return;
+	}
+	dirtyRects[dirtyRectCount].x = x;
+	dirtyRects[dirtyRectCount].y = y;
+	dirtyRects[dirtyRectCount].w = w;
+	dirtyRects[dirtyRectCount].h = h;
+	++dirtyRectCount;
+}
+
+static void markEatenPoints(void)
+{
+	int16_t x0 = (*_playerX / TILE_SIZE) * TILE_SIZE + POINT_OFFSET;
+	int16_t y0 = (*_playerY / TILE_SIZE) * TILE_SIZE + POINT_OFFSET;
+	int16_t x1 = ((*_playerX + playerSize - 1) / TILE_SIZE) * TILE_SIZE + POINT_OFFSET + POINT_SIZE;
+	int16_t y1 = ((*_playerY + playerSize - 1) / TILE_SIZE) * TILE_SIZE + POINT_OFFSET + POINT_SIZE;
+	if(!eatenPending) {
+		eatenX0 = x0;
+		eatenY0 = y0;
+		eatenX1 = x1;
+		eatenY1 = y1;
+		eatenPending = 1;
+		return;
+	}
+	if(x0 < eatenX0) {
+		eatenX0 = x0;
+	}
+	if(y0 < eatenY0) {
+		eatenY0 = y0;
+	}
+	if(x1 > eatenX1) {
+		eatenX1 = x1;
+	}
+	if(y1 > eatenY1) {
+		eatenY1 = y1;
+	}
+}
+#endif
+
+static void drawTile(maze_tile tile, uint8_t point, uint8_t tx, uint8_t ty)
+{
+	glcdBlitTilePgm((PGM_P)tileBitmaps[tileVariant(tile, point)], tx * TILE_SIZE, ty * TILE_SIZE);
+}
+
+static inline uint8_t onCamera(int16_t x, int16_t y, uint8_t w, uint8_t h)
+{
+	return (x < camX + SCREEN_WIDTH && x + w > camX && 
+			y < camY + SCREEN_HEIGHT && y + h > camY);
+}
+
+static uint8_t tileVariant(maze_tile tile, uint8_t point)
+{
+	return tile.tile.freeLeft | (tile.tile.freeRight << 1) | 
+		(tile.tile.freeTop << 2) | (tile.tile.freeBottom << 3) | 
+		(tile.tile.isEnd << 4) | ((point != 0) << 5);
+}
+
+#ifdef USE_STREAM_RENDER
+static void composeMazePage(const uint8_t page, uint8_t *line)
+{
+	if(streamTiles == NULL) {
+		memset(line, 0, SCREEN_WIDTH);
+	}
+	else {
+		// the page starts shift rows into tile row ty, and ends in the next 
+		// tile row unless it is aligned. The camera keeps that inside the maze.
+		int16_t worldY = camY + page * 8;
+		uint8_t ty = worldY / TILE_SIZE;
+		uint8_t shift = worldY % TILE_SIZE;
+		int16_t worldX = camX;
+		uint8_t x = 0;
+		while(x < SCREEN_WIDTH) {
+			uint8_t tx = worldX / TILE_SIZE;
+			uint8_t c = worldX % TILE_SIZE;
+			const uint8_t *upper = tileBitmaps[tileVariant(streamTiles[tx][ty], streamPoints[tx][ty])];
+			const uint8_t *lower = upper;
+			if(shift != 0) {
+				lower = tileBitmaps[tileVariant(streamTiles[tx][ty + 1], streamPoints[tx][ty + 1])];
+			}
+			for(; c < TILE_SIZE && x < SCREEN_WIDTH; ++c, ++x, ++worldX) {
+				uint8_t b = pgm_read_byte(&upper[c]) >> shift;
+				if(shift != 0) {
+					b |= pgm_read_byte(&lower[c]) << (8 - shift);
 				}
+				line[x] = b;
 			}
 		}
 	}
-	 
-	// above
-	if(!tile.tile.freeTop && p1Y >= 0) {
-		glcdDrawLine(topLeft, topRight, drawPx);
-	}
 	
-	// left
-	if(!tile.tile.freeLeft && p1X >= 0) {
-		glcdDrawLine(bottomLeft, topLeft, drawPx); 
+	if(streamPlayer) {
+		glcdComposeSprite(line, page, &pacmanSprite, pacmanFrame, *_playerX, *_playerY);
 	}
-	
-	// right
-	if(!tile.tile.freeRight && p2X < SCREEN_WIDTH) {
-		glcdDrawLine(topRight, bottomRight, drawPx); 
+	int16_t pageY = camY + page * 8;
+	for(uint8_t k = 0; k < streamGhostCount; ++k) {
+		const ghost *g = &streamGhosts[k];
+		if(g->y >= pageY + 8 || g->y + GHOST_H <= pageY || !onCamera(g->x, g->y, GHOST_W, GHOST_H)) {
+			continue;
+		}
+		glcdComposeSprite(line, page, &ghostSprite, 0, g->x, g->y);
 	}
 	
-	// bottom
-	if(!tile.tile.freeBottom && p2Y < SCREEN_HEIGHT) {
-		glcdDrawLine(bottomRight, bottomLeft, drawPx); 
+	// the minimap lines up with the pages
+	if(streamMinimap && page >= MINIMAP_Y / 8 && page < (MINIMAP_Y + MINIMAP_HEIGHT) / 8) {
+		memcpy(&line[MINIMAP_X], minimap[page - MINIMAP_Y / 8], MINIMAP_WIDTH);
 	}
-	
+}
+#endif
+
+void buildMinimap(maze_tile maze[][MAZE_HEIGHT], uint8_t points[][MAZE_HEIGHT])
+{
+	minimapTiles = maze;
+	minimapPoints = points;
+	minimapPlayerX = (*_playerX + playerSize / 2) / TILE_SIZE;
+	minimapPlayerY = (*_playerY + playerSize / 2) / TILE_SIZE;
+	for(uint8_t tx = 0; tx < MAZE_WIDTH; ++tx) {
+		for(uint8_t ty = 0; ty < MAZE_HEIGHT; ++ty) {
+			minimapCell(tx, ty);
+		}
+	}
+}
+
+void updateMinimap(void)
+{
+	if(minimapTiles == NULL) {
+		return;
+	}
+	// the tile the middle of the player is in
+	uint8_t tx = (*_playerX + playerSize / 2) / TILE_SIZE;
+	uint8_t ty = (*_playerY + playerSize / 2) / TILE_SIZE;
+	if(tx != minimapPlayerX || ty != minimapPlayerY) {
+		uint8_t oldX = minimapPlayerX;
+		uint8_t oldY = minimapPlayerY;
+		minimapPlayerX = tx;
+		minimapPlayerY = ty;
+		minimapCell(oldX, oldY);
+	}
+	// points are only eaten in the tile of the player
+	minimapCell(tx, ty);
+}
+
+void renderMinimap(void)
+{
+	if(minimapTiles == NULL) {
+		return;
+	}
+#ifdef USE_STREAM_RENDER
+	streamMinimap = 1;
+	return;
+#endif
+	glcdBlitBitmap(&minimap[0][0], MINIMAP_WIDTH, MINIMAP_HEIGHT, MINIMAP_X, MINIMAP_Y);
+#ifdef USE_HW_SCROLL
+	// the maze under the minimap is restored next frame like under a sprite
+	markRect(camX + MINIMAP_X, camY + MINIMAP_Y, MINIMAP_WIDTH, MINIMAP_HEIGHT);
+#endif
+}
+
+static void minimapCell(uint8_t tx, uint8_t ty)
+{
+	maze_tile tile = minimapTiles[tx][ty];
+	// the corner and the top wall in the left and right column of the
+	// upper row, the left wall and the point in those of the lower row
+	uint8_t left = 0x01 | (!tile.tile.freeLeft << 1);
+	uint8_t right = (!tile.tile.freeTop) | ((minimapPoints[tx][ty] != 0) << 1);
 	if(tile.tile.isEnd) {
-		glcdDrawLine(bottomRight, topLeft, drawPx);
-		glcdDrawLine(topRight, bottomLeft, drawPx);
+		left = right = 0x03;
 	}
+	if(tx == minimapPlayerX && ty == minimapPlayerY) {
+		left ^= 0x03;
+		right ^= 0x03;
+	}
+	
+	uint8_t row = ty * MINIMAP_SCALE;
+	uint8_t shift = row % 8;
+	uint8_t *col = &minimap[row / 8][tx * MINIMAP_SCALE];
+	col[0] = (col[0] & ~(0x03 << shift)) | (left << shift);
+	col[1] = (col[1] & ~(0x03 << shift)) | (right << shift);
 }
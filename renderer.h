@@ -41,18 +41,77 @@ void renderMaze(maze_tile maze[][MAZE_HEIGHT], uint8_t points[][MAZE_HEIGHT]);
 void renderGhosts(ghost ghosts[], uint8_t ghostCount);
 
 /**
- * @brief Flushes the framebuffer to the screen
+ * @brief Builds the minimap of a newly loaded maze.
+ *
+ * The minimap shows every tile as 2x2 pixels: the corner, the top wall,
+ * the left wall and the point. The exit is filled, the tile of the player
+ * is inverted. The maze and the points have to stay where they are.
+ * @param maze The maze to be shown.
+ * @param points 2D array containing the information which points are still visible.
+ */
+void buildMinimap(maze_tile maze[][MAZE_HEIGHT], uint8_t points[][MAZE_HEIGHT]);
+
+/**
+ * @brief Updates the minimap after a game tick.
+ *
+ * Only the tile of the player and the one it left are drawn again, so
+ * call it every tick, also while the minimap is not shown.
+ */
+void updateMinimap(void);
+
+/**
+ * @brief Draws the minimap over the top right corner of the maze frame.
+ *
+ * Call after renderGhosts().
+ */
+void renderMinimap(void);
+
+/**
+ * @brief Starts flushing the framebuffer to the screen.
+ *
+ * The flush is sent in slices by renderBckg(), and completed
+ * by the next call to startRender() if needed.
  */
 void endRender(void);
 
+/**
+ * @brief A background task which sends the next slice of the frame to the screen.
+ */
+void renderBckg(void);
+
+/**
+ * @brief Counts a frame which was not drawn because its tick ran out of time.
+ *
+ * Call after the game tick, the points eaten in it are removed by the 
+ * next drawn frame.
+ */
+void skipRender(void);
+
+/**
+ * @brief Returns how many frames were skipped with skipRender().
+ */
+uint16_t getSkippedFrameCount(void);
+
 /**
  * @brief Prepares the framebuffer for drawing.
  */
 void startRender(void);
 
+/**
+ * @brief Prepares the framebuffer for drawing the maze, the player and the ghosts.
+ *
+ * Call after updateCamera(). If the camera moved by less than a screen 
+ * in each direction since the last maze frame, the screen is scrolled and 
+ * the last frame is kept, so that renderMaze() only draws what changed. 
+ * Otherwise like startRender().
+ */
+void startMazeRender(void);
+
 /**
  * @brief Draws the end screen into the framebuffer.
  *
+ * Call without startRender(). The screen is composed once, later calls 
+ * with the same arguments only invert the button when it blinks.
  * @param won Function displays win message if won = 1, and lose message otherwise.
  * @param score Player's score to be drawn.
  */
@@ -65,6 +124,9 @@ void drawStartScreen(void);
 
 /**
  * @brief Draws the "waiting for wiimote" screen" into the framebuffer.
+ *
+ * Call without startRender(). The screen is composed once, later calls 
+ * only invert the message when it blinks.
  */
 void drawConnectingScreen(void);
 
@@ -0,0 +1,118 @@
+/*
+ * Host tool, packs a full screen image for glcdDrawRleImagePgm().
+ *
+ * Reads the 1024 bytes of an image in the glcdDrawArrayPgm() layout as
+ * comma separated numbers, e.g. the initializer of a PROGMEM array, and
+ * writes the packed image as a C array definition.
+ *
+ * usage: rle_encode name < image.txt > image.c
+ */
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PAGE_SIZE 128
+#define IMAGE_SIZE (8 * PAGE_SIZE)
+
+// same limits as the decoder in glcd.c
+#define MAX_LITERAL 128
+#define MIN_RUN 3
+#define MAX_RUN 130
+
+static unsigned char out[2 * IMAGE_SIZE];
+static unsigned outLen = 0;
+
+static int readImage(FILE *in, unsigned char *image)
+{
+	static char text[16 * IMAGE_SIZE];
+	size_t textLen = fread(text, 1, sizeof(text) - 1, in);
+	text[textLen] = '\0';
+
+	// skip the declaration, if any
+	char *p = strchr(text, '{');
+	p = (p != NULL) ? p + 1 : text;
+
+	unsigned len = 0;
+	for(;;) {
+		while(*p != '\0' && *p != '}' && !isdigit((unsigned char)*p)) {
+			++p;
+		}
+		if(*p == '\0' || *p == '}') {
+			break;
+		}
+		unsigned long value = strtoul(p, &p, 0);
+		if(value > 255 || len == IMAGE_SIZE) {
+			fprintf(stderr, "byte %u out of range or too many bytes\n", len);
+			return 0;
+		}
+		image[len++] = (unsigned char)value;
+	}
+	if(len != IMAGE_SIZE) {
+		fprintf(stderr, "expected %d bytes, got %u\n", IMAGE_SIZE, len);
+		return 0;
+	}
+	return 1;
+}
+
+static void flushLiteral(const unsigned char *from, unsigned n)
+{
+	if(n == 0) {
+		return;
+	}
+	out[outLen++] = (unsigned char)(n - 1);
+	for(unsigned i = 0; i < n; ++i) {
+		out[outLen++] = from[i];
+	}
+}
+
+// runs and literals never cross a page, so a page can be decoded on its own
+static void encodePage(const unsigned char *page)
+{
+	unsigned i = 0;
+	unsigned litStart = 0;
+	while(i < PAGE_SIZE) {
+		unsigned run = 1;
+		while(i + run < PAGE_SIZE && run < MAX_RUN && page[i + run] == page[i]) {
+			++run;
+		}
+		if(run >= MIN_RUN) {
+			flushLiteral(&page[litStart], i - litStart);
+			out[outLen++] = (unsigned char)(run - MIN_RUN + 128);
+			out[outLen++] = page[i];
+			i += run;
+			litStart = i;
+		} else {
+			i += run;
+			while(i - litStart >= MAX_LITERAL) {
+				flushLiteral(&page[litStart], MAX_LITERAL);
+				litStart += MAX_LITERAL;
+			}
+		}
+	}
+	flushLiteral(&page[litStart], PAGE_SIZE - litStart);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned char image[IMAGE_SIZE];
+	if(argc != 2) {
+		fprintf(stderr, "usage: %s name < image.txt > image.c\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	if(!readImage(stdin, image)) {
+		return EXIT_FAILURE;
+	}
+	for(unsigned page = 0; page < 8; ++page) {
+		encodePage(&image[page * PAGE_SIZE]);
+	}
+
+	printf("// packed with tools/rle_encode, %d bytes unpacked\n", IMAGE_SIZE);
+	printf("const uint8_t %s[%u] PROGMEM = {", argv[1], outLen);
+	for(unsigned i = 0; i < outLen; ++i) {
+		printf("%s%u%s", (i % 32 == 0) ? "\n" : "", out[i], (i + 1 < outLen) ? ", " : "");
+	}
+	printf("\n};\n");
+	fprintf(stderr, "%d -> %u bytes\n", IMAGE_SIZE, outLen);
+	return EXIT_SUCCESS;
+}